@@ -6,8 +6,15 @@
  */
 
 #include "jni.h"
+#include "constantpool.h"
 
 jobject JNICALL Java_java_lang_Class_getAllClasses(JNIEnv *env, jclass cl) {
+	// The Class instances are created on demand; create the missing ones:
+	int i;
+	for (i = 0; i < numberOfAllClassInstanceInfo && !ExceptionCheck(); i++) {
+		getJavaLangClass(i);
+	}
+
 	// The array of java.lang.Class:
 	return javaLangClassArray;
 
@@ -12,6 +12,7 @@
 #include "heaplist.h"
 
 #include "jni.h"
+#include "constantpool.h"
 #include "objectaccess.h"
 #include "vmids.h"
 
@@ -22,20 +23,8 @@ jint Java_java_lang_Object_hashCode(void *context, jobject this) {
 jobject JNICALL Java_java_lang_Object_getClass(JNIEnv *env, jobject this) {
 	u2 classId = oaGetClassIdFromObject(this);
 
-	// Find Class instance that has classId 'classId':
-	int i;
-	jobject class = NULL;
-	int len = GetArrayLength(javaLangClassArray);
-	u2 aClassIdLinkId = LINK_ID_java_lang_Class_aClassId_I;
-	for (i = 0; i < len && class == NULL; i++) {
-		jobject classObject = GetObjectArrayElement(javaLangClassArray, i);
-
-		jint classObjectDotaClassId = GetIntField(classObject, aClassIdLinkId);
-
-		if (classObjectDotaClassId == (jint) classId) {
-			class = classObject;
-		}
-	}
+	// The Class instances are created on demand, and the Class[] is indexed by class id:
+	jobject class = getJavaLangClass(classId);
 
 	if (class == NULL) {
 		DEB(consout("NULL class!!!"));
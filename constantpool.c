@@ -6,6 +6,7 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 #include "console.h"
 #include "constantpool.h"
 #include "objectaccess.h"
@@ -16,6 +17,8 @@
 #include "trace.h"
 #include "jni.h"
 #include "vmids.h"
+#include "vtable.h"
+#include "jarray.h"
 
 #define VALIDATE_CLASS_ID(X) \
 	if (X >= numberOfAllClassInstanceInfo) { \
@@ -50,25 +53,50 @@ static u2 getSuperClass(u2 classId) {
 	return getClassInfo(classId)->superClassId;
 }
 
-u2 getArrayClassIdForElementClassId(u2 elementClassId) {
-	BEGIN;
+// The value in the array class tables for 'no such class':
+#define NO_ARRAY_CLASS 0xffff
+
+// The class id of the object array class, indexed by the class id of the element class; see
+// cpBuildArrayClassTables():
+static u2* objectArrayClassIds = NULL;
+
+// The class id of the first class of each class type, indexed by class type; used to look up the
+// primitive array classes:
+static u2 firstClassIdOfType[CT_LONG_ARRAY + 1];
+
+void cpBuildArrayClassTables(void) {
+	objectArrayClassIds = heapAllocPermanent(numberOfAllClassInstanceInfo * sizeof(u2));
+
 	int i;
 	for (i = 0; i < numberOfAllClassInstanceInfo; i++) {
-		if (allClassInstanceInfo[i].elementClassId == elementClassId
-				&& allClassInstanceInfo[i].type == CT_OBJECT_ARRAY) {
-			break;
+		objectArrayClassIds[i] = NO_ARRAY_CLASS;
+	}
+	for (i = 0; i <= CT_LONG_ARRAY; i++) {
+		firstClassIdOfType[i] = NO_ARRAY_CLASS;
+	}
+
+	// Going backwards, so the first class of a kind is found, as the linear search used to do:
+	for (i = numberOfAllClassInstanceInfo - 1; i >= 0; i--) {
+		const classInstanceInfoDef* classInfo = &allClassInstanceInfo[i];
+		if (classInfo->type == CT_OBJECT_ARRAY) {
+			objectArrayClassIds[classInfo->elementClassId] = i;
+		}
+		if (classInfo->type <= CT_LONG_ARRAY) {
+			firstClassIdOfType[classInfo->type] = i;
 		}
 	}
+}
+
+u2 getArrayClassIdForElementClassId(u2 elementClassId) {
+	u2 classId = objectArrayClassIds[elementClassId];
 
-	if (i >= numberOfAllClassInstanceInfo) {
+	if (classId == NO_ARRAY_CLASS) {
 		consout("Array Class for element id = %d not found\n", elementClassId);
 		DUMP_STACKTRACE("class element id");
 		jvmexit(1);
 	}
 
-	END;
-	return i;
-
+	return classId;
 }
 
 /**
@@ -78,6 +106,79 @@ void getClassSize(u2 classId, u2* size) {
 	*size = getClassInfo(classId)->instanceSize;
 }
 
+/**
+ * The subtype information of a class:
+ */
+typedef struct __typeInfo {
+	// The number of super classes between the class and java.lang.Object:
+	u2 depth;
+	// The class and its super classes, indexed by depth: display[0] is java.lang.Object, and
+	// display[depth] is the class itself:
+	u2* display;
+	// The interfaces implemented by the class; a bitmap indexed by interface number:
+	u1* interfaces;
+	// The interface number; only defined if the class is an interface:
+	u2 interfaceNumber;
+} typeInfo;
+
+// The subtype information, indexed by class id; see cpBuildTypeTables():
+static typeInfo* typeInfos = NULL;
+
+void cpBuildTypeTables(void) {
+	typeInfos = heapAllocPermanent(numberOfAllClassInstanceInfo * sizeof(typeInfo));
+
+	// Depths and interface numbers:
+	size_t displaySize = 0;
+	u2 numberOfInterfaces = 0;
+	int i;
+	for (i = 0; i < numberOfAllClassInstanceInfo; i++) {
+		u2 depth = 0;
+		u2 classId = i;
+		while (classId != 0) {
+			classId = allClassInstanceInfo[classId].superClassId;
+			depth++;
+		}
+		typeInfos[i].depth = depth;
+		displaySize += depth + 1;
+
+		if (allClassInstanceInfo[i].type == CT_INTERFACE) {
+			typeInfos[i].interfaceNumber = numberOfInterfaces++;
+		}
+	}
+
+	// The displays, all in one block:
+	u2* display = heapAllocPermanent(displaySize * sizeof(u2));
+	for (i = 0; i < numberOfAllClassInstanceInfo; i++) {
+		typeInfos[i].display = display;
+		u2 classId = i;
+		int depth;
+		for (depth = typeInfos[i].depth; depth >= 0; depth--) {
+			display[depth] = classId;
+			classId = allClassInstanceInfo[classId].superClassId;
+		}
+		display += typeInfos[i].depth + 1;
+	}
+
+	// The interface bitmaps, all in one block:
+	size_t bitmapSize = (numberOfInterfaces + 7) / 8;
+	u1* interfaces = NULL;
+	if (bitmapSize > 0) {
+		interfaces = heapAllocPermanent(numberOfAllClassInstanceInfo * bitmapSize);
+		memset(interfaces, 0, numberOfAllClassInstanceInfo * bitmapSize);
+	}
+	for (i = 0; i < numberOfAllClassInstanceInfo; i++) {
+		typeInfos[i].interfaces = interfaces;
+		const classInstanceInfoDef* classInfo = &allClassInstanceInfo[i];
+		int j;
+		for (j = 0; j < classInfo->interface_count; j++) {
+			u2 interfaceNumber =
+					typeInfos[implementedInterfaces[classInfo->interface_start + j]].interfaceNumber;
+			interfaces[interfaceNumber >> 3] |= 1 << (interfaceNumber & 7);
+		}
+		interfaces += bitmapSize;
+	}
+}
+
 /**
  * This function tests if class S implements interface T
  * \param classId_S The class id to test
@@ -85,21 +186,14 @@ void getClassSize(u2 classId, u2* size) {
  * \return true, if implementing; false otherwise
  */
 BOOL is_S_implementing_T(u2 classId_S, u2 classId_T) {
-	BEGIN;
-	int interface_start;
-	int interface_count;
-	const classInstanceInfoDef* classInfo = getClassInfo(classId_S);
-
-	interface_start = classInfo->interface_start;
-	interface_count = classInfo->interface_count;
-
 	BOOL implements = FALSE;
-	int i;
-	for (i = 0; i < interface_count && !implements; i++) {
-		implements = implementedInterfaces[i + interface_start] == classId_T;
+
+	if (getClassType(classId_T) == CT_INTERFACE) {
+		u2 interfaceNumber = typeInfos[classId_T].interfaceNumber;
+		implements = (typeInfos[classId_S].interfaces[interfaceNumber >> 3] >> (interfaceNumber & 7))
+				& 1;
 	}
 
-	END;
 	return implements;
 }
 
@@ -110,20 +204,11 @@ BOOL is_S_implementing_T(u2 classId_S, u2 classId_T) {
  * \return true, if sub classing; false otherwise
  */
 BOOL is_S_SubClassing_T(u2 classId_S, u2 classId_T) {
-	BEGIN;
-	BOOL subclassing = FALSE;
-
-	while (!subclassing && classId_S != 0) {
-		const classInstanceInfoDef* class_S = getClassInfo(classId_S);
-		subclassing = class_S->superClassId == classId_T;
-		if (!subclassing) {
-			// Recurse up through super classes:
-			classId_S = class_S->superClassId;
-		}
-	}
+	const typeInfo* type_S = &typeInfos[classId_S];
+	u2 depth_T = typeInfos[classId_T].depth;
 
-	END;
-	return subclassing;
+	// T is a super class of S if it is found in the display of S at the depth of T:
+	return depth_T < type_S->depth && type_S->display[depth_T] == classId_T;
 }
 
 /**
@@ -205,6 +290,36 @@ void invokeNativeMethod(u2 nativeIndex) {
 	entry();
 }
 
+/**
+ * This method allocates the local variables of a byte code method (the arguments are already
+ * allocated) and pushes its frame
+ * \param numberOfLocals The number of local variables, which aren't arguments
+ * \param numberOfLocalVariables The number of local variables including the arguments
+ * \param classId The class id of the class containing the method
+ * \param codeOffset The address of the first instruction in the method
+ * \param returnFromVM See invokeCommon()
+ */
+static void sEnterMethod(int numberOfLocals, u2 numberOfLocalVariables, u2 classId,
+		codeIndex codeOffset, BOOL returnFromVM) {
+	// The stack is checked once for both the local variables and the frame record:
+	if (context.stackPointer + numberOfLocals + FRAME_RECORD_SIZE > STACK_SIZE) {
+		consout("stack overflow: %d", (int) (context.stackPointer));
+		jvmexit(1);
+	}
+	// Need to initialize stack space otherwise the marking phase of mark & sweep will see
+	// some the data on the stack as object refs:
+	stackable* local = &stack[context.stackPointer];
+	int i;
+	for (i = 0; i < numberOfLocals; i++) {
+		// Some non-GC critical dummy data:
+		local[i].type = JAVAINT;
+		local[i].operand.jrenameint = 0;
+	}
+	context.stackPointer += numberOfLocals;
+
+	push_frame(numberOfLocalVariables, classId, codeOffset, returnFromVM);
+}
+
 /**
  * This method will open a new frame and call the method indicated in the parameters.
  *
@@ -220,23 +335,78 @@ void invokeCommon(const methodInClass* mic, BOOL returnFromVM) {
 		;
 	} else {
 		//CALL(validateStackables(stack, context.operandStackPointer));
-		// Allocate space for local variables (arguments are already allocated):
-		// Need to initialize stack space otherwise the marking phase of mark & sweep will see
-		// some the data on the stack as object refs:
-		int i = mic->numberOfLocalVariables - mic->numberOfArguments;
-		while (i-- > 0) {
-			// Push some non-GC critical dummy data:
-			operandStackPushJavaInt(0);
-		}
-		// This is a no-go: context.operandStackPointer += localVariableCount - argumentCount;
-		// since it might leave jref - lookalikes on the stack, which might confuse GC
-
-		push_frame(mic->numberOfLocalVariables, mic->classId, mic->codeOffset, returnFromVM);
+		sEnterMethod(mic->numberOfLocalVariables - mic->numberOfArguments,
+				mic->numberOfLocalVariables, mic->classId, mic->codeOffset, returnFromVM);
 		//CALL(validateStackables(stack, context.operandStackPointer));
 	}
 	END;
 }
 
+/**
+ * This method invokes the native method of a call stub
+ */
+static void sInvokeNativeStub(const callStub* stub) {
+	invokeNativeMethod(stub->nativeIndex);
+}
+
+/**
+ * This method invokes the byte code method of a call stub; the frame geometry is taken from the
+ * stub
+ */
+static void sInvokeByteCodeStub(const callStub* stub) {
+	sEnterMethod(stub->numberOfLocals, stub->numberOfLocalVariables, stub->classId,
+			stub->codeOffset, FALSE);
+}
+
+// The call stubs, in the order of the methods of each class; see cpBuildCallStubs():
+static callStub* callStubs = NULL;
+// The index in callStubs of the first method of each class, indexed by class id:
+static u2* callStubOffsets = NULL;
+
+void cpBuildCallStubs(void) {
+	callStubOffsets = heapAllocPermanent(numberOfAllClassInstanceInfo * sizeof(u2));
+
+	size_t numberOfStubs = 0;
+	int i;
+	for (i = 0; i < numberOfAllClassInstanceInfo; i++) {
+		callStubOffsets[i] = numberOfStubs;
+		numberOfStubs += allConstantPools[i].numberOfMethods;
+	}
+
+	callStubs = NULL;
+	if (numberOfStubs > 0) {
+		callStubs = heapAllocPermanent(numberOfStubs * sizeof(callStub));
+	}
+
+	for (i = 0; i < numberOfAllClassInstanceInfo; i++) {
+		const constantPool* cpool = &allConstantPools[i];
+		int j;
+		for (j = 0; j < cpool->numberOfMethods; j++) {
+			const methodInClass* mic = &cpool->methods[j];
+			callStub* stub = &callStubs[callStubOffsets[i] + j];
+			stub->invoke = mic->nativeIndex > 0 ? sInvokeNativeStub : sInvokeByteCodeStub;
+			stub->method = mic;
+			stub->numberOfArguments = mic->numberOfArguments;
+			stub->numberOfLocalVariables = mic->numberOfLocalVariables;
+			stub->numberOfLocals = mic->numberOfLocalVariables - mic->numberOfArguments;
+			stub->classId = mic->classId;
+			stub->codeOffset = mic->codeOffset;
+			stub->nativeIndex = mic->nativeIndex;
+		}
+	}
+}
+
+const callStub* cpGetCallStub(const methodInClass* mic) {
+	const constantPool* cpool = &allConstantPools[mic->classId];
+
+	if (mic < cpool->methods || mic >= cpool->methods + cpool->numberOfMethods) {
+		consout("Not a method of class %d: linkId=%d\n", mic->classId, mic->linkId);
+		jvmexit(1);
+	}
+
+	return &callStubs[callStubOffsets[mic->classId] + (mic - cpool->methods)];
+}
+
 /**
  * This method returns the methodInClass with link id matching 'linkId' for the class identified
  * by class id 'classId'
@@ -288,33 +458,9 @@ const methodInClass* getVirtualMethodEntryByLinkId(jobject jref, u2 linkId) {
 	BEGIN;
 
 	int referencedClassId = oaGetClassIdFromObject(jref);
-	//printf("classId = %d, obj= %p\n", (int) referencedClassId, jref);
-	//jvmexit(1);
-	// Lookup method in referenced class or in it's super-classes:
-	const methodInClass* mic = NULL;
-	while (mic == NULL) {
-		//		for (i = 0; i < numberOfAllMethodsInAllClasses && !found; i++) {
-		//			if (allMethodsInAllClasses[i].classId == referencedClassId
-		//					&& allMethodsInAllClasses[i].linkId == linkId) {
-		//				found = TRUE;
-		//				methodId = i;
-		//			}
-		//		}
-		mic = getMethodInClass(referencedClassId, linkId);
-		if (mic == NULL) {
-			// Not found:
-			if (referencedClassId != JAVA_LANG_OBJECT_CLASS_ID) {
-				// Look in super class:
-				CALL(referencedClassId = getSuperClass(referencedClassId))
-				;
-			} else {
-				// Already in java.lang.Object; symbol not found.
-				break;
-			}
-		}
-	}
+	// The vtable contains the methods of the super classes as well:
+	const methodInClass* mic = vtGetMethodByLinkId(referencedClassId, linkId);
 
-	//printf("mic found: %d, refclassid = %d\n", found, referencedClassId);
 	if (mic == NULL) {
 		consout("Failed to look up virtual method entry: referencedClass = %d, linkId=%d\n",
 				oaGetClassIdFromObject(jref), linkId);
@@ -325,13 +471,7 @@ const methodInClass* getVirtualMethodEntryByLinkId(jobject jref, u2 linkId) {
 	return mic;
 }
 
-/**
- * This method looks up a reference to a method
- * \param classId the id of the referencing class
- * \param constantPoolIndex The index into the constant pool
- * \return The matching method reference. No return is made if no match
- */
-static const memberReference* lookupMethodReference(u2 classId, u2 constantPoolIndex) {
+const memberReference* lookupMethodReference(u2 classId, u2 constantPoolIndex) {
 	VALIDATE_CLASS_ID(classId);
 
 	const memberReference* const methodReferences = allConstantPools[classId].methodReferences;
@@ -442,29 +582,87 @@ const methodInClass* getStaticMethodEntry(u2 classId, u2 cp_index) {
 	//	return mic;
 }
 
-const fieldInClass* getFieldInClassbyLinkId(u2 classId, u2 linkId) {
-	u2 referencedClassId = classId;
+/**
+ * An entry in the field table; the field 'linkId' as seen from the class 'classId':
+ */
+typedef struct __fieldTableEntry {
+	u2 classId;
+	u2 linkId;
+	// The field, declared by the class or one of its super classes. NULL, if the entry is free:
+	const fieldInClass* field;
+} fieldTableEntry;
+
+// The field table; a hash table keyed by (classId, linkId), see cpBuildFieldTable():
+static fieldTableEntry* fieldTable = NULL;
+// The number of entries in the field table minus one; the number of entries is a power of 2:
+static u4 fieldTableMask = 0;
+
+/**
+ * This method returns the entry of (classId, linkId) in the field table: Either the entry holding
+ * the field, or the free entry where the field shall be inserted
+ */
+static fieldTableEntry* sGetFieldTableEntry(u2 classId, u2 linkId) {
+	u4 i = (classId * 31 + linkId) & fieldTableMask;
+
+	// Linear probing; the table is never full:
+	while (fieldTable[i].field != NULL
+			&& (fieldTable[i].classId != classId || fieldTable[i].linkId != linkId)) {
+		i = (i + 1) & fieldTableMask;
+	}
+
+	return &fieldTable[i];
+}
+
+void cpBuildFieldTable(void) {
+	// The number of fields seen from all classes, including the fields of the super classes:
+	size_t numberOfEntries = 0;
 	int i;
-	const fieldInClass* fic = NULL;
-	while (fic == NULL) {
-		const constantPool* cpool = &allConstantPools[referencedClassId];
-		const fieldInClass* allFields = cpool->fields;
-		size_t numberOfAllFields = cpool->numberOfFields;
-		for (i = 0; i < numberOfAllFields && fic == NULL; i++) {
-			if (allFields[i].linkId == linkId) {
-				fic = &allFields[i];
+	for (i = 0; i < numberOfAllClassInstanceInfo; i++) {
+		u2 classId = i;
+		for (;;) {
+			numberOfEntries += allConstantPools[classId].numberOfFields;
+			if (classId == JAVA_LANG_OBJECT_CLASS_ID) {
+				break;
 			}
+			classId = getSuperClass(classId);
 		}
-		if (fic == NULL) {
-			if (referencedClassId != JAVA_LANG_OBJECT_CLASS_ID) {
-				// Look in super class:
-				referencedClassId = getSuperClass(referencedClassId);
-			} else {
-				// Already in java.lang.Object; symbol not found.
+	}
+
+	// At most half full:
+	u4 size = 1;
+	while (size < 2 * numberOfEntries + 1) {
+		size <<= 1;
+	}
+	fieldTable = heapAllocPermanent(size * sizeof(fieldTableEntry));
+	fieldTableMask = size - 1;
+	for (i = 0; i < size; i++) {
+		fieldTable[i].field = NULL;
+	}
+
+	for (i = 0; i < numberOfAllClassInstanceInfo; i++) {
+		// Visit the class before its super classes:
+		u2 classId = i;
+		for (;;) {
+			const constantPool* cpool = &allConstantPools[classId];
+			int j;
+			for (j = 0; j < cpool->numberOfFields; j++) {
+				fieldTableEntry* entry = sGetFieldTableEntry(i, cpool->fields[j].linkId);
+				if (entry->field == NULL) {
+					entry->classId = i;
+					entry->linkId = cpool->fields[j].linkId;
+					entry->field = &cpool->fields[j];
+				}
+			}
+			if (classId == JAVA_LANG_OBJECT_CLASS_ID) {
 				break;
 			}
+			classId = getSuperClass(classId);
 		}
 	}
+}
+
+const fieldInClass* getFieldInClassbyLinkId(u2 classId, u2 linkId) {
+	const fieldInClass* fic = sGetFieldTableEntry(classId, linkId)->field;
 
 	if (fic == NULL) {
 		consout("Failed to look up field entry: classId = %d, linkId=%d\n", classId, linkId);
@@ -579,52 +777,143 @@ void getInstanceFieldEntry(u2 index, u2* address, u1* size) {
 }
 
 /**
- * This method looks up a constant within current class' constant pool
+ * An entry in the constant table of a class:
  */
-void getConstant(u2 constantPoolIndex, constantDef* constant) {
+typedef struct __constantTableEntry {
+	// TRUE, if the constant pool index refers to a constant:
+	u1 defined;
+	// The type of the constant:
+	u1 type;
+	// The index into the table of the type, e.g. allIntegerConstantReferences:
+	u2 index;
+} constantTableEntry;
+
+/**
+ * The constants of a class, indexed by constant pool index:
+ */
+typedef struct __constantTable {
+	// The number of entries; one more than the highest constant pool index of a constant:
+	u2 size;
+	constantTableEntry* entries;
+} constantTable;
+
+// The constant tables, indexed by class id; see cpBuildConstantTables():
+static constantTable* constantTables = NULL;
+
+stackable* internedStrings = NULL;
+
+/**
+ * This method makes room for the constant (classId, constantPoolIndex) in the constant tables
+ */
+static void sCountConstant(u2 classId, u2 constantPoolIndex) {
+	if (constantPoolIndex >= constantTables[classId].size) {
+		constantTables[classId].size = constantPoolIndex + 1;
+	}
+}
+
+/**
+ * This method adds the constant (classId, constantPoolIndex) to the constant tables
+ */
+static void sAddConstant(u2 classId, u2 constantPoolIndex, CONSTANT_TYPE type, u2 index) {
+	constantTableEntry* entry = &constantTables[classId].entries[constantPoolIndex];
+	entry->defined = TRUE;
+	entry->type = type;
+	entry->index = index;
+}
+
+void cpBuildConstantTables(void) {
+	constantTables = heapAllocPermanent(numberOfAllClassInstanceInfo * sizeof(constantTable));
+
 	int i;
-	BOOL found = FALSE;
-	for (i = 0; i < numberOfAllIntegerConstantReferences && !found; i++) {
-		if (allIntegerConstantReferences[i].classId == context.classIndex
-				&& allIntegerConstantReferences[i].constantPoolIndex == constantPoolIndex) {
-			found = TRUE;
-			constant->type = CONSTANT_INTEGER;
-			constant->value.jrenameint = allIntegerConstantReferences[i].value;
-		}
+	for (i = 0; i < numberOfAllIntegerConstantReferences; i++) {
+		sCountConstant(allIntegerConstantReferences[i].classId,
+				allIntegerConstantReferences[i].constantPoolIndex);
+	}
+	for (i = 0; i < numberOfAllLongConstantReferences; i++) {
+		sCountConstant(allLongConstantReferences[i].classId,
+				allLongConstantReferences[i].constantPoolIndex);
+	}
+	for (i = 0; i < numberOfAllStringConstantReferences; i++) {
+		sCountConstant(allStringConstantReferences[i].classId,
+				allStringConstantReferences[i].constantPoolIndex);
+	}
+	for (i = 0; i < numberOfAllClassReferences; i++) {
+		sCountConstant(allClassReferences[i].classId, allClassReferences[i].constantPoolIndex);
 	}
 
-	for (i = 0; i < numberOfAllLongConstantReferences && !found; i++) {
-		if (allLongConstantReferences[i].classId == context.classIndex
-				&& allLongConstantReferences[i].constantPoolIndex == constantPoolIndex) {
-			found = TRUE;
-			constant->type = CONSTANT_LONG;
-			constant->value.jlong = allLongConstantReferences[i].value;
-		}
+	// All entries in one block:
+	size_t numberOfEntries = 0;
+	for (i = 0; i < numberOfAllClassInstanceInfo; i++) {
+		numberOfEntries += constantTables[i].size;
+	}
+	constantTableEntry* entries = NULL;
+	if (numberOfEntries > 0) {
+		entries = heapAllocPermanent(numberOfEntries * sizeof(constantTableEntry));
+	}
+	for (i = 0; i < numberOfAllClassInstanceInfo; i++) {
+		constantTables[i].entries = entries;
+		entries += constantTables[i].size;
 	}
 
-	if (!found) {
-		for (i = 0; i < numberOfAllStringConstantReferences && !found; i++) {
-			if (allStringConstantReferences[i].classId == context.classIndex
-					&& allStringConstantReferences[i].constantPoolIndex == constantPoolIndex) {
-				found = TRUE;
-				constant->type = CONSTANT_STRING;
-				constant->value.string = (jchar*) allStringConstantReferences[i].value;
-			}
-		}
+	for (i = 0; i < numberOfAllIntegerConstantReferences; i++) {
+		sAddConstant(allIntegerConstantReferences[i].classId,
+				allIntegerConstantReferences[i].constantPoolIndex, CONSTANT_INTEGER, i);
+	}
+	for (i = 0; i < numberOfAllLongConstantReferences; i++) {
+		sAddConstant(allLongConstantReferences[i].classId,
+				allLongConstantReferences[i].constantPoolIndex, CONSTANT_LONG, i);
+	}
+	for (i = 0; i < numberOfAllStringConstantReferences; i++) {
+		sAddConstant(allStringConstantReferences[i].classId,
+				allStringConstantReferences[i].constantPoolIndex, CONSTANT_STRING, i);
+	}
+	for (i = 0; i < numberOfAllClassReferences; i++) {
+		sAddConstant(allClassReferences[i].classId, allClassReferences[i].constantPoolIndex,
+				CONSTANT_CLASS, i);
 	}
 
-	if (!found) {
-		for (i = 0; i < numberOfAllClassReferences && !found; i++) {
-			if (allClassReferences[i].classId == context.classIndex
-					&& allClassReferences[i].constantPoolIndex == constantPoolIndex) {
-				found = TRUE;
-				constant->type = CONSTANT_CLASS;
-				constant->value.classId = allClassReferences[i].targetClassId;
-			}
+	if (numberOfAllStringConstantReferences > 0) {
+		internedStrings = heapAllocPermanent(numberOfAllStringConstantReferences * sizeof(stackable));
+		for (i = 0; i < numberOfAllStringConstantReferences; i++) {
+			internedStrings[i].type = OBJECTREF;
+			internedStrings[i].operand.jref = NULL;
 		}
 	}
+}
+
+/**
+ * This method looks up a constant in the constant table of the current class
+ * \return The entry, or NULL, if the constant pool index doesn't refer to a constant
+ */
+static const constantTableEntry* sGetConstantTableEntry(u2 constantPoolIndex) {
+	const constantTable* table = &constantTables[context.classIndex];
+	const constantTableEntry* entry = NULL;
+
+	if (constantPoolIndex < table->size && table->entries[constantPoolIndex].defined) {
+		entry = &table->entries[constantPoolIndex];
+	}
+
+	return entry;
+}
 
-	if (!found) {
+/**
+ * This method looks up a constant within current class' constant pool
+ */
+void getConstant(u2 constantPoolIndex, constantDef* constant) {
+	const constantTableEntry* entry = sGetConstantTableEntry(constantPoolIndex);
+
+	if (entry != NULL) {
+		constant->type = entry->type;
+		if (entry->type == CONSTANT_INTEGER) {
+			constant->value.jrenameint = allIntegerConstantReferences[entry->index].value;
+		} else if (entry->type == CONSTANT_LONG) {
+			constant->value.jlong = allLongConstantReferences[entry->index].value;
+		} else if (entry->type == CONSTANT_STRING) {
+			constant->value.string = (jchar*) allStringConstantReferences[entry->index].value;
+		} else {
+			constant->value.classId = allClassReferences[entry->index].targetClassId;
+		}
+	} else {
 		// TODO support float & String!
 		consout("Missing support for float - or wrong index: %d\n", constantPoolIndex);
 		jvmexit(1);
@@ -636,17 +925,11 @@ void getConstant(u2 constantPoolIndex, constantDef* constant) {
  * \param classId The class reference / id
  */
 void getClassReference(u2 constantPoolIndex, u2* classId) {
-	int i;
-	BOOL found = FALSE;
-	for (i = 0; i < numberOfAllClassReferences && !found; i++) {
-		if (allClassReferences[i].constantPoolIndex == constantPoolIndex
-				&& allClassReferences[i].classId == context.classIndex) {
-			found = TRUE;
-			*classId = allClassReferences[i].targetClassId;
-		}
-	}
+	const constantTableEntry* entry = sGetConstantTableEntry(constantPoolIndex);
 
-	if (!found) {
+	if (entry != NULL && entry->type == CONSTANT_CLASS) {
+		*classId = allClassReferences[entry->index].targetClassId;
+	} else {
 		consout("Failed to look up class reference: index = %d, classId=%d\n", constantPoolIndex,
 				context.classIndex);
 		jvmexit(1);
@@ -692,16 +975,9 @@ u2 getArrayElementClassId(u2 classId) {
 }
 
 u2 getClassIdForClassType(CLASS_TYPE type) {
-	int i;
-	u2 classId;
-	for (i = 0; i < numberOfAllClassInstanceInfo; i++) {
-		if (type == allClassInstanceInfo[i].type) {
-			classId = i;
-			break;
-		}
-	}
+	u2 classId = type <= CT_LONG_ARRAY ? firstClassIdOfType[type] : NO_ARRAY_CLASS;
 
-	if (i >= numberOfAllClassInstanceInfo) {
+	if (classId == NO_ARRAY_CLASS) {
 		consoutli("Failed to look up type=%d\n", type);
 		jvmexit(1);
 	}
@@ -709,8 +985,15 @@ u2 getClassIdForClassType(CLASS_TYPE type) {
 	return classId;
 }
 
+// The address of java.lang.Class.aClassId; see getClassIdOfJavaLangClass():
+static u2 aClassIdAddress;
+
 void generateJavaLangClassInstances() {
-	// Allocate Class[] containing only those classes that are referenced:
+	aClassIdAddress = getFieldInClassbyLinkId(CLASS_ID_java_lang_Class,
+			LINK_ID_java_lang_Class_aClassId_I)->address;
+
+	// Allocate Class[] indexed by class id. The Class instances are created on demand by
+	// getJavaLangClass():
 	javaLangClassArray = NewObjectArray((jint) numberOfAllClassInstanceInfo,
 			CLASS_ID_java_lang_Class, NULL);
 
@@ -718,31 +1001,19 @@ void generateJavaLangClassInstances() {
 		// Don't GC our array of classes:
 		heapProtect(javaLangClassArray, TRUE);
 
-		int i;
-		for (i = 0; i < numberOfAllClassInstanceInfo; i++) {
-			// Simulate: Class cl  = new Class();
-			// TODO NewObject !!!
-			// TODO Lazy load?
-			u2 size;
-			getClassSize(CLASS_ID_java_lang_Class, &size);
-			jobject jc = heapAllocObjectByStackableSize(size, CLASS_ID_java_lang_Class);
-			SetIntField(jc, LINK_ID_java_lang_Class_aClassId_I, i);
-			if (ExceptionCheck()) {
-				break;
-			}
-
-			SetObjectArrayElement(javaLangClassArray, i, jc);
-			if (ExceptionCheck()) {
-				break;
-			}
-		}
-
 		// Set the aAllClasses in java.lang.Class:
 		jclass classInstance = getJavaLangClass(CLASS_ID_java_lang_Class);
-		SetStaticObjectField(classInstance, LINK_ID_java_lang_Class_aAllClasses__Ljava_lang_Class_,
-				javaLangClassArray);
+		if (!ExceptionCheck()) {
+			SetStaticObjectField(classInstance,
+					LINK_ID_java_lang_Class_aAllClasses__Ljava_lang_Class_, javaLangClassArray);
+		}
+
+		// The garbage collector looks up java.lang.Thread, so it can't be created on demand:
+		if (!ExceptionCheck()) {
+			getJavaLangClass(CLASS_ID_java_lang_Thread);
+		}
 
-		// No need of protection:
+		// No need of protection; referenced by java.lang.Class.aAllClasses:
 		heapProtect(javaLangClassArray, FALSE);
 	}
 	// consout("class init done\n");
@@ -750,8 +1021,29 @@ void generateJavaLangClassInstances() {
 }
 
 jclass getJavaLangClass(u2 requestedClassId) {
-	// TODO Lazy load ?
-	return (jclass) GetObjectArrayElement(javaLangClassArray, requestedClassId);
+	// The Class[] is indexed by class id, so no bounds check is needed:
+	jclass jc = NULL;
+	jobject* classes = (jobject*) jaGetArrayPayLoad(javaLangClassArray);
+	if (classes != NULL) {
+		jc = (jclass) classes[requestedClassId];
+	}
+
+	if (jc == NULL && !ExceptionCheck()) {
+		// Simulate: Class cl  = new Class();
+		u2 size;
+		getClassSize(CLASS_ID_java_lang_Class, &size);
+		jc = heapAllocObjectByStackableSize(size, CLASS_ID_java_lang_Class);
+		if (jc != NULL) {
+			SetIntField(jc, LINK_ID_java_lang_Class_aClassId_I, requestedClassId);
+			SetObjectArrayElement(javaLangClassArray, requestedClassId, jc);
+		}
+	}
+
+	return jc;
+}
+
+u2 getClassIdOfJavaLangClass(jclass cls) {
+	return GetField(cls, aClassIdAddress)->operand.jrenameint;
 }
 
 void deprecated_generateJavaLangClassInstances() {
@@ -854,6 +1146,34 @@ jclass deprecated_getJavaLangClass(u2 requestedClassId) {
 	return (jclass) GetObjectArrayElement(javaLangClassArray, index);
 }
 
+/**
+ * This method returns the canonical String object of a string constant. The String is created the
+ * first time the constant is loaded; string constants with equal values share the same String.
+ * \param index The index of the constant in allStringConstantReferences
+ */
+static jstring sGetInternedString(u2 index) {
+	jstring str = internedStrings[index].operand.jref;
+
+	if (str == NULL) {
+		const char* value = allStringConstantReferences[index].value;
+		int i;
+		for (i = 0; i < numberOfAllStringConstantReferences && str == NULL; i++) {
+			if (internedStrings[i].operand.jref != NULL
+					&& strcmp(allStringConstantReferences[i].value, value) == 0) {
+				str = internedStrings[i].operand.jref;
+			}
+		}
+
+		if (str == NULL) {
+			str = NewString((const jchar*) value);
+		}
+		// The table is a root, so the String is referenced from now on:
+		internedStrings[index].operand.jref = str;
+	}
+
+	return str;
+}
+
 void cpCommonLDC(u2 constantPoolIndex) {
 	// Look up value (int, float or String) from within const pool:
 	constantDef constant;
@@ -863,8 +1183,7 @@ void cpCommonLDC(u2 constantPoolIndex) {
 	} else if (constant.type == CONSTANT_LONG) {
 		operandStackPushJavaLong(constant.value.jlong);
 	} else if (constant.type == CONSTANT_STRING) {
-		//		consout("%s:%d ldc string: %d\n", __FILE__, __LINE__, constantPoolIndex);
-		jobject str = NewString(constant.value.string);
+		jobject str = sGetInternedString(sGetConstantTableEntry(constantPoolIndex)->index);
 		operandStackPushObjectRef(str);
 	} else if (constant.type == CONSTANT_CLASS) {
 		//registerNatives skal bygge det Class[], der skal foretages lookup i:
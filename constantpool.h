@@ -206,6 +206,10 @@ extern const int staticMemorySize;
 
 extern stackable staticMemory[];
 
+// The String objects of the string constants loaded by ldc, indexed as allStringConstantReferences.
+// An entry is NULL until the constant has been loaded. Part of the root set of the garbage collector:
+extern stackable* internedStrings;
+
 extern const classInstanceInfoDef const allClassInstanceInfo[];
 extern const u2 numberOfAllClassInstanceInfo;
 
@@ -270,17 +274,26 @@ extern const u2 numberOfAllBuildinMemberDependencies;
 #endif
 
 /**
- * This method generates the Class[] to be used for Object.getClass(), Class.class (named javaLangClassArray):
+ * This method generates the Class[] to be used for Object.getClass(), Class.class (named javaLangClassArray).
+ * The Class[] is indexed by class id; the Class instances are created on demand by getJavaLangClass():
  */
 extern void generateJavaLangClassInstances();
 
 /**
- * This method returns the Class - instance corresponding to the supplied classId.
+ * This method returns the Class - instance corresponding to the supplied classId. The instance is
+ * created the first time it is requested, which might trigger a garbage collection.
  * \param requestedClassId the id to resolve
  * \return The resolved jclass
  */
 extern jclass getJavaLangClass(u2 requestedClassId);
 
+/**
+ * This method returns the class id of a Class - instance; the inverse of getJavaLangClass().
+ * \param cls The Class - instance
+ * \return The class id
+ */
+u2 getClassIdOfJavaLangClass(jclass cls);
+
 /**
  * This method invokes a native method identified by the parameter
  * \param nativeIndex The index (+1) into the native jump table
@@ -295,6 +308,14 @@ void invokeNativeMethod(u2 nativeIndex);
  */
 const methodInClass* getVirtualMethodEntry(u2 index);
 
+/**
+ * This method looks up a reference to a method
+ * \param classId the id of the referencing class
+ * \param constantPoolIndex The index into the constant pool
+ * \return The matching method reference. No return is made if no match
+ */
+const memberReference* lookupMethodReference(u2 classId, u2 constantPoolIndex);
+
 /**
  * This method looks up a static method of a class.
  *
@@ -329,6 +350,19 @@ void getStaticFieldEntry(u2 index, u2* address, u1* size);
  * \param linkId The id to look up with
  * \return A pointer to the fieldInClass struct. If no match => no return
  */
+/**
+ * This method builds the field table used by getFieldInClassbyLinkId(): A hash table mapping
+ * (class id, link id) to the field, declared by the class or one of its super classes. Shall be
+ * called when the VM is reset, since the table is allocated in the VM tables area.
+ */
+void cpBuildFieldTable(void);
+
+/**
+ * This method looks up a field of a class in the field table
+ * \param classId The class id
+ * \param linkId The link id of the field, declared by the class or one of its super classes
+ * \return The field. If not found, the method will exit the vm.
+ */
 const fieldInClass* getFieldInClassbyLinkId(u2 classId, u2 linkId);
 
 /**
@@ -339,6 +373,22 @@ const fieldInClass* getFieldInClassbyLinkId(u2 classId, u2 linkId);
  */
 void getInstanceFieldEntry(u2 index, u2* address, u1* size);
 
+/**
+ * This method builds the constant tables used by getConstant() and getClassReference(): For each
+ * class a table of the constants, directly indexed by constant pool index. Also allocates the table
+ * of interned strings. Shall be called when the VM is reset, since the tables are allocated in the
+ * VM tables area.
+ */
+void cpBuildConstantTables(void);
+
+/**
+ * This method builds the tables used by the subtype tests is_S_SubClassing_T() and
+ * is_S_implementing_T(): For each class the display of its super classes and a bitmap of its
+ * interfaces. Shall be called when the VM is reset, since the tables are allocated in the VM
+ * tables area.
+ */
+void cpBuildTypeTables(void);
+
 /**
  * This method looks up a constant within current class' constant pool
  */
@@ -362,6 +412,13 @@ void getClassReference(u2 constantPoolIndex, u2* classId);
 // */
 //void getArrayInfo(u2 classId, u2* elementClassId, size_t* size);
 
+/**
+ * This method builds the tables used by getArrayClassIdForElementClassId() and
+ * getClassIdForClassType(). Shall be called when the VM is reset, since the tables are allocated
+ * in the VM tables area.
+ */
+void cpBuildArrayClassTables(void);
+
 /**
  * This method returns the class id of the first class having the indicated type.
  * \param type The class type to search for
@@ -466,6 +523,43 @@ const methodInClass* getVirtualMethodEntryByLinkId(jobject jref, u2 linkId);
  */
 void invokeCommon(const methodInClass* mic, BOOL returnFromVM);
 
+/**
+ * A method linked for invocation from call sites. The invocation path (native or byte code) and
+ * the frame geometry are decided when the stub is built, so invoking through a stub doesn't
+ * examine the method definition:
+ */
+typedef struct __callStub {
+	// Invokes the method like invokeCommon(method, FALSE) does:
+	void (*invoke)(const struct __callStub* stub);
+	// The method:
+	const methodInClass* method;
+	// The number of arguments, including 'this':
+	u2 numberOfArguments;
+	// The number of local variables, including the arguments:
+	u2 numberOfLocalVariables;
+	// The number of local variables which aren't arguments; these are cleared by the invocation:
+	u2 numberOfLocals;
+	// The class containing the method:
+	u2 classId;
+	// The address of the method:
+	codeIndex codeOffset;
+	// The index (+1) into the native jump table, if the method is native:
+	u2 nativeIndex;
+} callStub;
+
+/**
+ * This method builds the call stubs of all methods. Shall be called when the VM is reset, since
+ * the stubs are allocated in the VM tables area.
+ */
+void cpBuildCallStubs(void);
+
+/**
+ * This method returns the call stub of a method
+ * \param mic The method, as found in the methods of its class' constant pool
+ * \return The call stub
+ */
+const callStub* cpGetCallStub(const methodInClass* mic);
+
 #if 0
 /**
  * This method returns the classId of the build-in dependency identified by libref
@@ -18,6 +18,8 @@
 #include "instructions.h"
 #include "debugger.h"
 #include "vmids.h"
+#include "threadedcode.h"
+#include "vtable.h"
 
 // The JVM 'cpu' registers etc:
 contextDef context;
@@ -47,44 +49,53 @@ static BOOL aSchedulingEnabled = FALSE;
  * fp-> arg
  */
 void pop_frame() {
-	// set stack pointer to fixed point at stack:
-	context.stackPointer = context.contextPointer;
+	// The frame record is found just below the context pointer:
+	const stackable* record = &stack[context.contextPointer - FRAME_RECORD_SIZE];
+	VALIDATE_TYPE(record[0].type, U2);
 
 	// pop context including return address:
-	context.flags = operandStackPopU2();
-	context.contextPointer = operandStackPopU2();
-	context.classIndex = operandStackPopU2();
-	context.programCounter = operandStackPopU2(); // This is the return
-	u2 framePointer = operandStackPopU2();
+	u2 framePointer = record[0].operand.u2pair.first;
+	context.programCounter = record[0].operand.u2pair.second; // This is the return
+	context.classIndex = record[1].operand.u2pair.first;
+	context.contextPointer = record[1].operand.u2pair.second;
+	context.flags = record[2].operand.u2pair.first;
 	context.stackPointer = context.framePointer;
 	context.framePointer = framePointer;
 	// Don't touch context.exceptionThrown
 }
 
 void push_frame(u1 localVariableCount, u2 dstClassIndex, codeIndex dest, BOOL returnFromVM) {
-	// Push previous frame pointer:
-	operandStackPushU2(context.framePointer);
-	// Push return address:
-	operandStackPushU2(context.programCounter);
-	// Push current class index:
-	operandStackPushU2(context.classIndex);
-	// Push current context pointer:
-	operandStackPushU2(context.contextPointer);
-	// Push flags:
+	if (context.stackPointer + FRAME_RECORD_SIZE > STACK_SIZE) {
+		consout("stack overflow: %d", (int) (context.stackPointer));
+		jvmexit(1);
+	}
+
 	if (returnFromVM) {
 		context.flags |= RETURN_FROM_VM;
 	} else {
 		context.flags &= ~RETURN_FROM_VM;
 	}
-	operandStackPushU2(context.flags);
+
+	// Push previous frame pointer, return address, current class index, current context pointer
+	// and flags:
+	stackable* record = &stack[context.stackPointer];
+	record[0].type = U2;
+	record[0].operand.u2pair.first = context.framePointer;
+	record[0].operand.u2pair.second = context.programCounter;
+	record[1].type = U2;
+	record[1].operand.u2pair.first = context.classIndex;
+	record[1].operand.u2pair.second = context.contextPointer;
+	record[2].type = U2;
+	record[2].operand.u2pair.first = context.flags;
+	record[2].operand.u2pair.second = 0;
+	context.stackPointer += FRAME_RECORD_SIZE;
+
 	// Clear return - flag:
 	context.flags = 0;
 	// Save address of context:
 	context.contextPointer = context.stackPointer;
 
-	size_t numberOfPushedRegisters = 5;
-
-	context.framePointer = context.stackPointer - localVariableCount - numberOfPushedRegisters;
+	context.framePointer = context.stackPointer - localVariableCount - FRAME_RECORD_SIZE;
 	context.classIndex = dstClassIndex;
 	context.programCounter = dest;
 
@@ -196,7 +207,7 @@ BOOL isBreakpoint(codeIndex addr) {
 	return found;
 }
 #endif // USE_DEBUG
-void resetVM(align_t* heap, size_t heapSize, size_t stackSize) {
+void resetVM(align_t* heap, size_t heapSize, size_t stackSize, align_t* tables, size_t tablesSize) {
 	// STACK_SIZE is in count of stackables, not bytes:
 	STACK_SIZE = stackSize / sizeof(stackable);
 
@@ -208,10 +219,30 @@ void resetVM(align_t* heap, size_t heapSize, size_t stackSize) {
 #endif // USE_DEBUG
 	// Initialize heap:
 	heapInit(heap, heapSize);
+	heapInitTables(tables, tablesSize);
 
 	// Clear static area:
 	memset(&staticMemory[0], staticMemorySize, sizeof(stackable));
 
+	// The interned strings were allocated in the previous tables area:
+	internedStrings = NULL;
+
+	// Build the dispatch, constant, type, field and array class tables and the call stubs in the
+	// new tables area:
+	vtReset();
+	cpBuildConstantTables();
+	cpBuildTypeTables();
+	cpBuildFieldTable();
+	cpBuildCallStubs();
+	cpBuildArrayClassTables();
+
+	// The threaded code was allocated in the previous tables area:
+	tcReset();
+
+	// The threads were allocated on the previous heap; java.lang.Thread.<clinit> starts the scheduling
+	// again:
+	aSchedulingEnabled = FALSE;
+
 	// Setup initial context:
 	clearContext(&context, startClassIndex, startAddress);
 
@@ -272,14 +303,10 @@ void frStartScheduling() {
 	aSchedulingEnabled = TRUE;
 }
 
-// TODO Make time-base!
-static int yieldCount = 0;
-void tryYield() {
-	if (aSchedulingEnabled) {
-		if (yieldCount++ >= 100) {
-			yieldCount = 0;
-			jclass cls = getJavaLangClass(CLASS_ID_java_lang_Thread);
-			Java_java_lang_Thread_yield(NULL, cls);
-		}
-	}
+/**
+ * This method lets another thread run. The context shall be valid when calling this method.
+ */
+void frYield() {
+	jclass cls = getJavaLangClass(CLASS_ID_java_lang_Thread);
+	Java_java_lang_Thread_yield(NULL, cls);
 }
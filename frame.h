@@ -19,14 +19,29 @@ extern "C" {
 #include "constantpool.h"
 
 /**
- * Flags for context:
+ * Flags for context:
  */
 /**
  * When the RETURN_FROM_VM flag is set (happens during pop_frame, if RETURN_FROM_VM_PENDING is set)
- * the execute() - function shall return
+ * the execute() - function shall return
  */
 #define RETURN_FROM_VM 0x01
 
+/**
+ * The number of stackables in the frame record saved on the stack by push_frame(): The caller's
+ * frame pointer and program counter, class index and context pointer, and flags. The record is
+ * written and read as a whole; each stackable holds two u2 values and is typed U2, so the GC never
+ * takes the record for references.
+ */
+#define FRAME_RECORD_SIZE 3
+
+/**
+ * The number of safepoints (backward branches, invokes and returns) passed by execute() between
+ * each attempt to yield
+ */
+// TODO Make time-base!
+#define YIELD_POLL_INTERVAL 20
+
 // The 'cpu' registers in the JVM:
 typedef struct __contextDef {
 	codeIndex programCounter;
@@ -80,8 +95,10 @@ void singleStep(void);
  * \param heap A pointer to the memory area where the heap will be placed
  * \param heapSize The size of the heap area
  * \param stackSize The size of a thread stack in bytes
+ * \param tables A pointer to the memory area where the tables of the VM will be placed
+ * \param tablesSize The size of the tables area (in count of align_t)
  */
-void resetVM(align_t* heap, size_t heapSize, size_t stackSize);
+void resetVM(align_t* heap, size_t heapSize, size_t stackSize, align_t* tables, size_t tablesSize);
 
 /*
  * This method dumps a stack trace of current (thread)..
@@ -120,6 +137,11 @@ BOOL frIsSchedulingEnabled();
  */
 void frStartScheduling();
 
+/**
+ * This method lets another thread run. The context shall be saved before calling this method.
+ */
+void frYield();
+
 #ifdef  __cplusplus
 }
 #endif
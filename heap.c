@@ -5,6 +5,8 @@
  *      Author: hammer
  */
 
+#include <string.h>
+
 #include "config.h"
 #include "jni.h"
 #include "jarray.h"
@@ -21,25 +23,327 @@ static unsigned int markValue;
 
 size_t HEAP_HEADER_SIZE;
 
+/**
+ * Objects are allocated in the nursery by bumping a pointer. When the nursery is full, the
+ * surviving objects are promoted into the heap list (the old space) by heapScavenge(), and the
+ * nursery is emptied. The nursery is the last 1/NURSERY_FRACTION of the heap memory. Objects
+ * larger than 1/NURSERY_OBJECT_FRACTION of the nursery are allocated in the old space directly.
+ */
+#define NURSERY_FRACTION 16
+#define NURSERY_OBJECT_FRACTION 4
+
+static align_t* nurseryStart;
+static align_t* nurseryTop;
+static align_t* nurseryEnd;
+
+// The size of the largest object allocated in the nursery (in align_t, including the header):
+static size_t nurseryMaxObjectSize;
+
+// TRUE, if the nursery has been full since the last scavenge:
+static BOOL scavengePending;
+
+// TRUE, if the last scavenge was given up, because the old space couldn't hold the nursery. The
+// nursery isn't scavenged again, until the free memory in the old space has changed by at least
+// a quarter of the nursery; see sAllocYoung():
+static BOOL scavengeBackedOff;
+static size_t scavengeBackedOffFreeBytes;
+
+// The number of protected objects in the nursery; these can't be moved:
+static int youngProtectedCount;
+
+/**
+ * The remembered set holds the old objects which might refer to objects in the nursery. It is
+ * maintained by heapWriteBarrier(). If it overflows, the whole old space is scanned instead.
+ */
+#define REMEMBERED_SET_SIZE 64
+
+static header_t* rememberedSet[REMEMBERED_SET_SIZE];
+static int rememberedSetSize;
+static BOOL rememberedSetOverflow;
+
+/**
+ * The old space is compacted, when an allocation fails in spite of enough free memory, or when the
+ * fragmentation has grown after a mark and sweep: The size of the largest free element in percent
+ * of the free memory has dropped below FRAGMENTATION_THRESHOLD percent of the same figure after
+ * the last compaction.
+ */
+#define FRAGMENTATION_THRESHOLD 25
+
+// TRUE, if the old space shall be compacted at the next safepoint:
+static BOOL compactionPending;
+
+// The size of the largest free element in percent of the free memory after the last compaction.
+// Pinned objects might prevent a compaction from getting rid of all fragmentation:
+static size_t compactedLargestFreePercentage;
+
+// TRUE, if the current allocation may compact the old space; see heapSetCompactionAllowed():
+static BOOL compactionAllowed;
+
+// The promoted objects not yet scanned by heapScavenge(), linked through e.next:
+static header_t* scanHead;
+static header_t* scanTail;
+
+/**
+ * The marking is incremental (tri-color, snapshot at the beginning): When the free memory in the
+ * old space drops below markingThreshold, the roots are shaded grey at a safepoint. Hereafter each
+ * allocation and each safepoint scans about MARK_STEP_SIZE references of the grey objects, until
+ * no grey objects are left; then the old space is swept at the next safepoint. heapWriteBarrier()
+ * shades the references overwritten in the heap, and the objects allocated while marking are
+ * black, so all objects live at the start of the marking are marked. The stacks and the static
+ * memory aren't guarded by the barrier; they are scanned at the start of the marking only.
+ */
+#define MARK_STEP_SIZE 64
+#define GREY_STACK_SIZE 128
+
+// The grey objects not scanned yet. If the stack overflows, the remaining grey objects are found by
+// walking the heap; see sRefillGreyStack():
+static header_t* greyStack[GREY_STACK_SIZE];
+static int greyStackSize;
+static BOOL greyStackOverflow;
+
+// TRUE, while marking:
+static BOOL marking;
+
+// TRUE, from the end of a marking until the lazy sweep of the old space has been seen to finish;
+// see sFinishSweep():
+static BOOL sweeping;
+
+// The memory for the VM tables and the next unused part of it; see heapAllocPermanent():
+static align_t* tablesStart;
+static align_t* tablesTop;
+static align_t* tablesEnd;
+
+// The marking is started, when the free memory in the old space drops below this value (in bytes);
+// see sSetMarkingThreshold():
+static size_t markingThreshold;
+
+/**
+ * This method sets the threshold for starting the next marking: Half of the free memory not needed
+ * to promote a full nursery, so the marking can finish before heapScavenge() has to mark and sweep
+ * the old space itself.
+ */
+static void sSetMarkingThreshold(void) {
+	size_t freeBytes = heap_free_bytes();
+	size_t nurseryBytes = (nurseryEnd - nurseryStart) * sizeof(align_t);
+
+	markingThreshold = nurseryBytes;
+	if (freeBytes > nurseryBytes) {
+		markingThreshold += (freeBytes - nurseryBytes) / 2;
+	}
+}
+
 void heapInit(align_t* heap, size_t size) {
 	HEAP_HEADER_SIZE = ToAlignedSize(sizeof(header_t));
 
-	heap_init(heap, size);
+	size_t nurserySize = size / NURSERY_FRACTION;
+	heap_init(heap, size - nurserySize);
+
+	nurseryStart = heap + size - nurserySize;
+	nurseryTop = nurseryStart;
+	nurseryEnd = heap + size;
+	nurseryMaxObjectSize = nurserySize / NURSERY_OBJECT_FRACTION;
+	scavengePending = FALSE;
+	scavengeBackedOff = FALSE;
+	youngProtectedCount = 0;
+	rememberedSetSize = 0;
+	rememberedSetOverflow = FALSE;
+	compactionPending = FALSE;
+	compactionAllowed = FALSE;
+	compactedLargestFreePercentage = 100;
+	greyStackSize = 0;
+	greyStackOverflow = FALSE;
+	marking = FALSE;
+	sweeping = FALSE;
+	sSetMarkingThreshold();
+
 	// Never let markValue == 0:
 	markValue = 1;
 }
 
+/**
+ * \return TRUE, if obj is allocated in the nursery
+ */
+static BOOL sIsYoung(jobject obj) {
+	align_t* a = (align_t*) obj;
+	return nurseryStart <= a && a < nurseryEnd;
+}
+
+/**
+ * This method allocates an element in the nursery
+ * \param size The size of the element (in align_t, including the header)
+ * \return The allocated element, or NULL if the nursery is full
+ */
+static header_t* sAllocYoung(size_t size) {
+	header_t* h = NULL;
+
+	if (size <= (size_t) (nurseryEnd - nurseryTop)) {
+		h = (header_t*) nurseryTop;
+		nurseryTop += size;
+
+		memset(h, 0, size * sizeof(align_t));
+		set_type(h, HT_USED);
+		h->e.size = size;
+	} else if (scavengeBackedOff) {
+		size_t freeBytes = heap_free_bytes();
+		size_t changed = freeBytes > scavengeBackedOffFreeBytes ? freeBytes - scavengeBackedOffFreeBytes
+				: scavengeBackedOffFreeBytes - freeBytes;
+		if (changed >= (nurseryEnd - nurseryStart) * sizeof(align_t) / 4) {
+			scavengeBackedOff = FALSE;
+			scavengePending = TRUE;
+		}
+	} else {
+		scavengePending = TRUE;
+	}
+
+	return h;
+}
+
+/**
+ * This method shades an object grey, unless it is marked already
+ * \param obj The object to shade; might be NULL
+ */
+static void sShade(jobject obj) {
+	if (obj != NULL) {
+		header_t* h = getHeader(obj);
+		if (h->e.mark != markValue) {
+			h->e.mark = markValue;
+			h->e.grey = 1;
+			if (greyStackSize < GREY_STACK_SIZE) {
+				greyStack[greyStackSize++] = h;
+			} else {
+				greyStackOverflow = TRUE;
+			}
+		}
+	}
+}
+
+/**
+ * This method shades all objects referenced from 'memory'
+ * \param memory The array of stackable to scan
+ * \param size The number of elements in 'memory'
+ */
+static void sShadeStackables(stackable* memory, size_t size) {
+	size_t i;
+	for (i = 0; i < size; i++) {
+		if (memory[i].type == OBJECTREF) {
+			sShade(memory[i].operand.jref);
+		}
+	}
+}
+
+/**
+ * This method shades the objects referenced from a grey object, making the object itself black
+ * \param h The grey object
+ * \return The number of references scanned
+ */
+static size_t sScanGrey(header_t* h) {
+	jobject obj = getObjectFromHeader(h);
+	size_t scanned = 0;
+
+	h->e.grey = 0;
+	if (isObjectArray(h->e.classId)) {
+		// Not by jaGetArrayPayLoad(); that one fails if an exception is pending:
+		jobject* elements = (jobject*) ((align_t*) GetObjectPayload(obj) + GetAlignedArraySize(0));
+		size_t length = GetArrayLength(obj);
+		for (scanned = 0; scanned < length; scanned++) {
+			sShade(elements[scanned]);
+		}
+	} else if (!isPrimitiveValueArray(h->e.classId)) {
+		u2 size;
+		getClassSize(h->e.classId, &size);
+		sShadeStackables(GetObjectPayload(obj), size);
+		scanned = size;
+	}
+
+	return scanned;
+}
+
+/**
+ * This method pushes an element onto the grey stack, if it is grey
+ * \param h The element
+ */
+static void sPushIfGrey(header_t* h) {
+	if (h->e.grey) {
+		if (greyStackSize < GREY_STACK_SIZE) {
+			greyStack[greyStackSize++] = h;
+		} else {
+			greyStackOverflow = TRUE;
+		}
+	}
+}
+
+/**
+ * This method finds the grey objects left out by an overflow of the grey stack
+ */
+static void sRefillGreyStack(void) {
+	greyStackOverflow = FALSE;
+
+	heap_for_each_used(sPushIfGrey);
+	align_t* a = nurseryStart;
+	while (a < nurseryTop) {
+		sPushIfGrey((header_t*) a);
+		a += ((header_t*) a)->e.size;
+	}
+}
+
+/**
+ * This method scans grey objects until about 'budget' references have been scanned
+ * \param budget The number of references to scan
+ * \return TRUE, if no grey objects are left, i.e. the marking is complete
+ */
+static BOOL sMarkStep(size_t budget) {
+	size_t scanned = 0;
+	while (scanned < budget) {
+		if (greyStackSize > 0) {
+			// Count the object itself as well, so primitive arrays also consume the budget:
+			scanned += sScanGrey(greyStack[--greyStackSize]) + 1;
+		} else if (greyStackOverflow) {
+			sRefillGreyStack();
+		} else {
+			return TRUE;
+		}
+	}
+
+	return greyStackSize == 0 && !greyStackOverflow;
+}
+
 jobject heapAllocObjectByByteSize(u2 size, u2 classId) {
-	header_t* h = heap_alloc(ToAlignedSize(size));
+	header_t* h = NULL;
+	if (ToAlignedSize(size) + HEAP_HEADER_SIZE <= nurseryMaxObjectSize) {
+		h = sAllocYoung(ToAlignedSize(size) + HEAP_HEADER_SIZE);
+	}
+
+	if (h == NULL) {
+		h = heap_alloc(ToAlignedSize(size));
+	}
 	if (h == NULL) {
+		// Only this allocation may compact; not the ones made while throwing OutOfMemoryError:
+		BOOL mayCompact = compactionAllowed;
+		compactionAllowed = FALSE;
+
 		markAndSweep();
 		h = heap_alloc(ToAlignedSize(size));
+
+		if (h == NULL && heap_free_bytes() >= (ToAlignedSize(size) + HEAP_HEADER_SIZE) * sizeof(align_t)) {
+			// Enough memory, but fragmented:
+			if (mayCompact) {
+				heapCompact();
+				h = heap_alloc(ToAlignedSize(size));
+			} else {
+				compactionPending = TRUE;
+			}
+		}
 	}
 
 	if (h != NULL) {
 		h->e.classId = classId;
-		// The mark - field is already init to 0 => it is always != markValue as long it isn't marked
-		// => it can be garbage collected, and it will not by incident look like it is marked
+		if (marking) {
+			// Allocated black:
+			h->e.mark = markValue;
+			sMarkStep(MARK_STEP_SIZE);
+		}
+		// else: The mark - field is already init to 0 => it is always != markValue as long it isn't
+		// marked => it can be garbage collected, and it will not by incident look like it is marked
 	} else {
 		//		consout("out of mem friends!\n");
 		throwOutOfMemoryError();
@@ -52,112 +356,78 @@ jobject heapAllocObjectByStackableSize(u2 size, u2 classId) {
 	return heapAllocObjectByByteSize(size * sizeof(stackable), classId);
 }
 
+jobject heapAllocTenuredObjectByByteSize(u2 size, u2 classId) {
+	header_t* h = heap_alloc(ToAlignedSize(size));
+	if (h == NULL) {
+		markAndSweep();
+		h = heap_alloc(ToAlignedSize(size));
+	}
+
+	if (h != NULL) {
+		h->e.classId = classId;
+		h->e.pinned = 1;
+		if (marking) {
+			h->e.mark = markValue;
+		}
+	} else {
+		throwOutOfMemoryError();
+	}
+
+	return (jobject) h;
+}
+
+void heapSetCompactionAllowed(BOOL allowed) {
+	compactionAllowed = allowed;
+}
+
 void heapProtect(jobject jref, BOOL protected) {
 	header_t* h = jref;
+	if (sIsYoung(jref) && !protected != !is_type(h, HT_PROTECTED)) {
+		youngProtectedCount += protected ? 1 : -1;
+	}
 	set_type(h, protected ? HT_PROTECTED : HT_USED);
 }
 
-/**
- * This method marks all objects referenced from the 'memory'
- * \param memory The arary of stackable to search
- * \size The number of elements in 'memory'
- */
-static void mark2(stackable* memory, size_t size);
-
-static void markObject3(jobject obj) {
-	HEAP_VALIDATE;
-	header_t* curList;
-	header_t* nxtList;
-	if (obj != NULL) {
-		curList = getHeader(obj);
-		curList->e.next = NULL;
+void heapWriteBarrier(jobject obj, jobject oldValue, jobject value) {
+	if (marking) {
+		// The overwritten object was live at the start of the marking; it might still be referenced
+		// from a stack:
+		sShade(oldValue);
 	}
 
-	nxtList = NULL;
-	while (curList != NULL) {
-		HEAP_VALIDATE;
-		header_t* h = curList;
-		curList = curList->e.next;
-		h->e.next = NULL;
-		obj = getObjectFromHeader(h);
-
-		if (h->e.mark != markValue) {
-			// Mark now to avoid future visits:
-			h->e.mark = markValue;
-
-			if (isObjectArray(h->e.classId)) {
-				jobjectArray arr = (jobjectArray) obj;
-				size_t length = GetArrayLength(arr);
-				size_t i;
-				for (i = 0; i < length; i++) {
-					jobject element = GetObjectArrayElement(arr, i);
-					if (element != NULL) {
-						// Insert into next list;
-						h = getHeader(element);
-						// TODO hvis to elementer peger på samme object, risikerer vi så at collecte live objecsts?
-						if (h->e.next == NULL) {
-							if (nxtList == NULL) {
-								h->e.next = h;
-								nxtList = h;
-							} else {
-								h->e.next = nxtList->e.next;
-								nxtList->e.next = h;
-							}
-						}
-						// else: Already in list
-					}
-				}
-			} else if (isPrimitiveValueArray(h->e.classId)) {
-				// Ignore
+	if (value != NULL && sIsYoung(value) && !sIsYoung(obj)) {
+		header_t* h = getHeader(obj);
+		if (!h->e.remembered) {
+			if (rememberedSetSize < REMEMBERED_SET_SIZE) {
+				h->e.remembered = 1;
+				rememberedSet[rememberedSetSize++] = h;
 			} else {
-				// A 'normal' object with stackables:
-				stackable* memory = GetObjectPayload(obj);
-				u2 size;
-				getClassSize(h->e.classId, &size);
-				size_t i;
-				for (i = 0; i < size; i++) {
-					if (memory[i].type == OBJECTREF) {
-						if (memory[i].operand.jref != NULL) {
-							h = getHeader(memory[i].operand.jref);
-
-							// TODO hvis to elementer peger på samme object, risikerer vi så at collecte live objecsts?
-							if (h->e.next == NULL) {
-								if (nxtList == NULL) {
-									h->e.next = h;
-									nxtList = h;
-								} else {
-									h->e.next = nxtList->e.next;
-									nxtList->e.next = h;
-								}
-							}
-							// else: Already in list
-
-						}
-					}
-				}
+				rememberedSetOverflow = TRUE;
 			}
 		}
-		// else: Already marked
+	}
+}
 
-		if (curList == NULL) {
-			curList = nxtList;
-			nxtList = NULL;
-		}
+void heapInitTables(align_t* tables, size_t tablesSize) {
+	tablesStart = tables;
+	tablesTop = tables;
+	tablesEnd = tables + tablesSize;
+}
 
-		HEAP_VALIDATE;
+void* heapAllocPermanent(size_t size) {
+	size_t alignedSize = ToAlignedSize(size);
+	if (alignedSize > (size_t) (tablesEnd - tablesTop)) {
+		consout("Out of memory; can't alloc %d bytes for VM tables (%d of %d bytes used)\n",
+				(int) size, (int) ((tablesTop - tablesStart) * sizeof(align_t)),
+				(int) ((tablesEnd - tablesStart) * sizeof(align_t)));
+		jvmexit(1);
 	}
-}
 
-static void mark2(stackable* memory, size_t size) {
-	HEAP_VALIDATE;
-	size_t i;
-	for (i = 0; i < size; i++) {
-		if (memory[i].type == OBJECTREF) {
-			if (memory[i].operand.jref != NULL) {
-				markObject3(memory[i].operand.jref);
-			}
-		}
-	}HEAP_VALIDATE;
+	align_t* block = tablesTop;
+	tablesTop += alignedSize;
+	memset(block, 0, alignedSize * sizeof(align_t));
+
+	return block;
 }
 
 static stackable* sGetThreadStack(jobject stackThread) {
@@ -175,18 +445,20 @@ static void sGetThreadContext(jobject stackThread, contextDef* contp) {
 	GetByteArrayRegion(ba, 0, sizeof(contextDef), (jbyte*) contp);
 }
 
-void markAndSweep(void) {
-	//	consoutli("Mark & Sweep\n");
-	//	heap_dump();
-	HEAP_VALIDATE;
-	// The mark field in header_t is MARK_BIT_SIZE bits only. Avoiding the value '0' will
-	// ensure that a newly created, not protected object will always != markValue
-	// => it can be collected:
-	markValue = (markValue + 2) & ((1 << MARK_BIT_SIZE) - 1);
-
-	// Mark:
-	mark2(staticMemory, staticMemorySize);
-
+/**
+ * This method calls visit for each array of stackables holding references to the heap: The stacks
+ * of all threads, the static memory and the interned strings
+ * \param visit The function to call
+ */
+static void sForEachRoot(void (*visit)(stackable* memory, size_t size)) {
+	// The collection might run at a safepoint right after an instruction has thrown an exception. The
+	// flag isn't cleared until the next context instruction, but the JNI functions below fail, if it
+	// is set:
+	BOOL exceptionThrown = context.exceptionThrown;
+	context.exceptionThrown = FALSE;
+
+	// The stacks are visited first; visit might change the static memory holding the list of threads
+	// (see heapCompact()):
 	if (frIsSchedulingEnabled()) {
 		// Iterate through all threads:
 		jclass threadClass = getJavaLangClass(CLASS_ID_java_lang_Thread);
@@ -207,7 +479,7 @@ void markAndSweep(void) {
 				// The context contained in the thread is only updated during thread switching:
 				stackPointer = context.stackPointer;
 			}
-			mark2(stack, stackPointer);
+			visit(stack, stackPointer);
 
 			// Next thread:
 			stackThread = GetObjectField(stackThread,
@@ -215,10 +487,98 @@ void markAndSweep(void) {
 		}
 	} else {
 		// The java.lang.Thread.<clinit> hasn't finished yet, so only a single thread is running:
-		mark2(getStack(), context.stackPointer);
+		visit(getStack(), context.stackPointer);
+	}
+
+	visit(staticMemory, staticMemorySize);
+	if (internedStrings != NULL) {
+		visit(internedStrings, numberOfAllStringConstantReferences);
+	}
+
+	context.exceptionThrown = exceptionThrown;
+}
+
+/**
+ * This method finishes the lazy sweep started by sSweep(), if not finished by the allocations
+ * already. The fragmentation is checked, when the sweep has finished.
+ */
+static void sFinishSweep(void) {
+	heap_sweep_finish();
+
+	if (sweeping) {
+		sweeping = FALSE;
+
+		size_t freeBytes = heap_free_bytes();
+		if (heap_largest_free_bytes() * 100 * 100
+				< freeBytes * compactedLargestFreePercentage * FRAGMENTATION_THRESHOLD) {
+			compactionPending = TRUE;
+		}
+		sSetMarkingThreshold();
+	}
+}
+
+/**
+ * This method starts an incremental marking by shading the roots grey. The objects in the nursery
+ * are marked as well, but only the old space is swept.
+ */
+static void sStartMarking(void) {
+	// The mark field in header_t is MARK_BIT_SIZE bits only. Avoiding the value '0' will
+	// ensure that a newly created, not protected object will always != markValue
+	// => it can be collected:
+	// The lazy sweep decides by the mark value as well:
+	sFinishSweep();
+	markValue = (markValue + 2) & ((1 << MARK_BIT_SIZE) - 1);
+
+	greyStackSize = 0;
+	greyStackOverflow = FALSE;
+	marking = TRUE;
+
+	sForEachRoot(sShadeStackables);
+}
+
+/**
+ * This method marks all live objects; the incremental marking is finished, if started
+ */
+static void sCompleteMarking(void) {
+	if (!marking) {
+		sStartMarking();
+	}
+	while (!sMarkStep(MARK_STEP_SIZE)) {
+		// Continue
+	}
+	marking = FALSE;
+}
+
+/**
+ * This method starts freeing the objects in the old space not marked by the last marking. The sweep
+ * is lazy; the garbage is freed by the allocations needing the memory, see heap_sweep_lazily().
+ */
+static void sSweep(void) {
+	// Forget the remembered objects about to be swept:
+	int i;
+	int j = 0;
+	for (i = 0; i < rememberedSetSize; i++) {
+		header_t* h = rememberedSet[i];
+		if (h->e.mark == markValue || is_type(h, HT_PROTECTED)) {
+			rememberedSet[j++] = h;
+		} else {
+			h->e.remembered = 0;
+		}
 	}
+	rememberedSetSize = j;
+
 	// Sweep heap:
-	heap_sweep(markValue);
+	heap_sweep_lazily(markValue);
+	sweeping = TRUE;
+}
+
+void markAndSweep(void) {
+	//	consoutli("Mark & Sweep\n");
+	//	heap_dump();
+	HEAP_VALIDATE;
+
+	sCompleteMarking();
+	sSweep();
 
 	//	heap_dump();
 	//	consoutli("End Of Mark & Sweep\n");
@@ -226,6 +586,301 @@ void markAndSweep(void) {
 	HEAP_VALIDATE;
 }
 
+/**
+ * This method promotes an object in the nursery into the old space. The promoted object is queued
+ * for scanning.
+ * \param obj The object to promote
+ * \return The promoted object; obj itself, if obj isn't in the nursery
+ */
+static jobject sPromote(jobject obj) {
+	if (obj == NULL || !sIsYoung(obj)) {
+		return obj;
+	}
+
+	header_t* h = getHeader(obj);
+	if (h->e.next == NULL) {
+		// Not promoted yet. heapScavenge() ensures that a single free element can hold the nursery, so
+		// this can't fail:
+		header_t* copy = heap_alloc(h->e.size - HEAP_HEADER_SIZE);
+		if (copy == NULL) {
+			consout("Out of memory; can't promote %d bytes\n", (int) (h->e.size * sizeof(align_t)));
+			jvmexit(1);
+		}
+
+		memcpy((align_t*) copy + HEAP_HEADER_SIZE, (align_t*) h + HEAP_HEADER_SIZE,
+				(h->e.size - HEAP_HEADER_SIZE) * sizeof(align_t));
+		copy->e.classId = h->e.classId;
+		// Still white, if not reached by the marking yet:
+		copy->e.mark = h->e.mark;
+		copy->e.grey = h->e.grey;
+
+		// Append to the queue of objects to scan:
+		if (scanTail == NULL) {
+			scanHead = copy;
+		} else {
+			scanTail->e.next = copy;
+		}
+		scanTail = copy;
+
+		// The forwarding address:
+		h->e.next = copy;
+	}
+
+	return getObjectFromHeader(h->e.next);
+}
+
+/**
+ * This method promotes all objects in the nursery referenced from 'memory'
+ * \param memory The array of stackable to update
+ * \param size The number of elements in 'memory'
+ */
+static void sPromoteStackables(stackable* memory, size_t size) {
+	size_t i;
+	for (i = 0; i < size; i++) {
+		if (memory[i].type == OBJECTREF) {
+			memory[i].operand.jref = sPromote(memory[i].operand.jref);
+		}
+	}
+}
+
+/**
+ * This method promotes all objects in the nursery referenced from the object h
+ * \param h The object to scan
+ */
+static void sPromoteReferents(header_t* h) {
+	jobject obj = getObjectFromHeader(h);
+
+	if (isObjectArray(h->e.classId)) {
+		// Not by jaGetArrayPayLoad(); that one fails if an exception is pending:
+		jobject* elements = (jobject*) ((align_t*) GetObjectPayload(obj) + GetAlignedArraySize(0));
+		size_t length = GetArrayLength(obj);
+		size_t i;
+		for (i = 0; i < length; i++) {
+			elements[i] = sPromote(elements[i]);
+		}
+	} else if (!isPrimitiveValueArray(h->e.classId)) {
+		u2 size;
+		getClassSize(h->e.classId, &size);
+		sPromoteStackables(GetObjectPayload(obj), size);
+	}
+}
+
+BOOL heapIsCollectionPending(void) {
+	return scavengePending || compactionPending || marking
+			|| (sweeping ? !heap_is_sweeping() : heap_free_bytes() < markingThreshold);
+}
+
+BOOL heapIsMarking(void) {
+	return marking;
+}
+
+void heapCollectPending(void) {
+	if (scavengePending) {
+		heapScavenge();
+	}
+	if (compactionPending) {
+		heapCompact();
+	}
+
+	if (marking) {
+		if (sMarkStep(MARK_STEP_SIZE)) {
+			marking = FALSE;
+			sSweep();
+		}
+	} else if (sweeping) {
+		if (!heap_is_sweeping()) {
+			sFinishSweep();
+		}
+	} else if (heap_free_bytes() < markingThreshold) {
+		sStartMarking();
+	}
+}
+
+void heapScavenge(void) {
+	HEAP_VALIDATE;
+
+	if (youngProtectedCount > 0) {
+		// Somebody holds on to a protected object in the nursery; try again later:
+		return;
+	}
+
+	// Promoting can't be undone half way, so the old space shall be able to hold every object in the
+	// nursery. The free memory might be fragmented; if the largest free element can hold the
+	// nursery, all objects fit. The extra header allows for the element not being split, when the
+	// remainder is a header only:
+	size_t nurseryUsed = (nurseryTop - nurseryStart + HEAP_HEADER_SIZE) * sizeof(align_t);
+	if (heap_largest_free_bytes() < nurseryUsed) {
+		// The garbage not swept yet might do; else mark and sweep:
+		heap_sweep_step(nurseryUsed);
+	}
+	if (heap_largest_free_bytes() < nurseryUsed && heap_free_bytes() < nurseryUsed) {
+		markAndSweep();
+		sFinishSweep();
+	}
+	if (heap_largest_free_bytes() < nurseryUsed && heap_free_bytes() >= nurseryUsed) {
+		// Enough memory, but fragmented:
+		heapCompact();
+	}
+	if (heap_largest_free_bytes() < nurseryUsed) {
+		// The old space can't hold the survivors; new objects are allocated in the old space until
+		// enough memory has been freed (or out of memory is thrown):
+		scavengePending = FALSE;
+		scavengeBackedOff = TRUE;
+		scavengeBackedOffFreeBytes = heap_free_bytes();
+		return;
+	}
+
+	scanHead = NULL;
+	scanTail = NULL;
+
+	// Promote the objects referenced from the roots:
+	sForEachRoot(sPromoteStackables);
+	javaLangClassArray = sPromote(javaLangClassArray);
+
+	// ... and the grey objects of the marking, which are about to move:
+	int i;
+	for (i = 0; i < greyStackSize; i++) {
+		greyStack[i] = getHeader(sPromote(getObjectFromHeader(greyStack[i])));
+	}
+
+	// ... and from the old space:
+	for (i = 0; i < rememberedSetSize; i++) {
+		rememberedSet[i]->e.remembered = 0;
+		sPromoteReferents(rememberedSet[i]);
+	}
+	if (rememberedSetOverflow) {
+		heap_for_each_used(sPromoteReferents);
+	}
+	rememberedSetSize = 0;
+	rememberedSetOverflow = FALSE;
+
+	// Promote the objects referenced from the promoted objects (breadth first):
+	while (scanHead != NULL) {
+		header_t* h = scanHead;
+		scanHead = h->e.next;
+		if (scanHead == NULL) {
+			scanTail = NULL;
+		}
+		h->e.next = NULL;
+		sPromoteReferents(h);
+	}
+
+	// Now the nursery contains garbage only:
+	nurseryTop = nurseryStart;
+	scavengePending = FALSE;
+
+	HEAP_VALIDATE;
+}
+
+/**
+ * This method returns the address, that an object is moved to by heap_compact()
+ * \param obj The object
+ * \return The new address of obj
+ */
+static jobject sForward(jobject obj) {
+	if (obj != NULL && !sIsYoung(obj)) {
+		header_t* h = getHeader(obj);
+		if (h->e.next != NULL) {
+			obj = getObjectFromHeader(h->e.next);
+		}
+	}
+
+	return obj;
+}
+
+/**
+ * This method updates the references in 'memory' to the addresses after compaction
+ * \param memory The array of stackable to update
+ * \param size The number of elements in 'memory'
+ */
+static void sForwardStackables(stackable* memory, size_t size) {
+	size_t i;
+	for (i = 0; i < size; i++) {
+		if (memory[i].type == OBJECTREF) {
+			memory[i].operand.jref = sForward(memory[i].operand.jref);
+		}
+	}
+}
+
+/**
+ * This method updates the references in the object h to the addresses after compaction
+ * \param h The object to update
+ */
+static void sForwardReferents(header_t* h) {
+	jobject obj = getObjectFromHeader(h);
+
+	if (isObjectArray(h->e.classId)) {
+		jobject* elements = (jobject*) ((align_t*) GetObjectPayload(obj) + GetAlignedArraySize(0));
+		size_t length = GetArrayLength(obj);
+		size_t i;
+		for (i = 0; i < length; i++) {
+			elements[i] = sForward(elements[i]);
+		}
+	} else if (!isPrimitiveValueArray(h->e.classId)) {
+		u2 size;
+		getClassSize(h->e.classId, &size);
+		sForwardStackables(GetObjectPayload(obj), size);
+	}
+}
+
+/**
+ * This method updates the references in a live object in the old space; see heap_set_forwarding()
+ * \param h The object to update
+ */
+static void sForwardReferentsIfLive(header_t* h) {
+	if (h->e.next != NULL) {
+		sForwardReferents(h);
+	}
+}
+
+void heapCompact(void) {
+	HEAP_VALIDATE;
+
+	// Mark; the live objects in the nursery are marked as well, since they are updated too:
+	sCompleteMarking();
+
+	heap_set_forwarding(markValue);
+
+	// Update the references from the roots:
+	sForEachRoot(sForwardStackables);
+	javaLangClassArray = sForward(javaLangClassArray);
+
+	// ... from the remembered set:
+	int i;
+	int j = 0;
+	for (i = 0; i < rememberedSetSize; i++) {
+		header_t* h = rememberedSet[i];
+		if (h->e.next != NULL) {
+			rememberedSet[j++] = h->e.next;
+		} else {
+			h->e.remembered = 0;
+		}
+	}
+	rememberedSetSize = j;
+
+	// ... from the old space and the nursery:
+	heap_for_each_used(sForwardReferentsIfLive);
+	align_t* a = nurseryStart;
+	while (a < nurseryTop) {
+		header_t* h = (header_t*) a;
+		if (h->e.mark == markValue) {
+			sForwardReferents(h);
+		}
+		a += h->e.size;
+	}
+
+	heap_compact();
+	compactionPending = FALSE;
+
+	size_t freeBytes = heap_free_bytes();
+	if (freeBytes > 0) {
+		compactedLargestFreePercentage = heap_largest_free_bytes() * 100 / freeBytes;
+	}
+	sSetMarkingThreshold();
+
+	HEAP_VALIDATE;
+}
+
 void getHeapStat(heapListStat* usedStat, heapListStat* freeStat, gcStat* gc) {
 	consout("not impl");
 	jvmexit(1);
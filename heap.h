@@ -74,7 +74,8 @@ jobject heapAllocObjectByByteSize(u2 size, u2 classId);
 void heapInit(align_t* heap, size_t heapSize);
 
 /**
- * This method executes simple garbage collection using mark and sweep algorithm.
+ * This method executes simple garbage collection using mark and sweep algorithm. A running
+ * incremental marking is finished. The garbage is swept lazily by the following allocations.
  */
 void markAndSweep(void);
 
@@ -95,6 +96,84 @@ void getHeapStat(heapListStat* usedStat, heapListStat* freeStat, gcStat* gc);
  */
 void heapProtect(jobject jref, BOOL protected);
 
+/**
+ * This method allocates a java object in the old space, i.e. outside the nursery. Objects which
+ * must never move (like thread stacks) shall be allocated by this method. The payload is cleared.
+ * \param size The size of the java object - in count of bytes
+ * \param classId The identification the class contained in the object
+ * \return The allocated object, or NULL if out of memory, in which case an OutOfMemoryError has
+ * been thrown
+ */
+jobject heapAllocTenuredObjectByByteSize(u2 size, u2 classId);
+
+/**
+ * This method shall be called when a reference is stored into an object, so the nursery can be
+ * scavenged without scanning the old space, and so an incremental marking doesn't lose the
+ * object previously referenced.
+ * \param obj The object written to
+ * \param oldValue The reference overwritten in obj; NULL if none
+ * \param value The reference stored in obj; NULL if none
+ */
+void heapWriteBarrier(jobject obj, jobject oldValue, jobject value);
+
+/**
+ * This method allows the allocations following it to compact the old space, if no element is
+ * large enough. It shall be allowed only while no references are held outside the stacks, the
+ * static memory and the heap; see heapCompact().
+ * \param allowed TRUE, if the allocations may compact
+ */
+void heapSetCompactionAllowed(BOOL allowed);
+
+/**
+ * \return TRUE, if a scavenge, a compaction or a step of the incremental marking shall be done at
+ * the next safepoint
+ */
+BOOL heapIsCollectionPending(void);
+
+/**
+ * \return TRUE, while an incremental marking is in progress
+ */
+BOOL heapIsMarking(void);
+
+/**
+ * This method does the pending scavenge and compaction, and starts, continues or finishes the
+ * incremental marking. Shall be called from a safepoint in execute() only; see heapScavenge().
+ */
+void heapCollectPending(void);
+
+/**
+ * This method promotes the live objects in the nursery into the old space and empties the nursery.
+ * The objects are moved, so no references may be held outside the stacks, the static memory and
+ * the heap, i.e. it shall be called from a safepoint in execute() only. The context shall be
+ * valid when calling this method.
+ */
+void heapScavenge(void);
+
+/**
+ * This method marks the live objects and slides them towards the start of the old space, so the
+ * free memory becomes contiguous. Protected objects and objects allocated by
+ * heapAllocTenuredObjectByByteSize() are not moved. The objects in the nursery are not moved
+ * either, but their references are updated. As for heapScavenge(), no references may be held
+ * outside the stacks, the static memory and the heap when calling this method.
+ */
+void heapCompact(void);
+
+/**
+ * This method initializes the memory for the internal tables of the VM; see heapAllocPermanent()
+ * \param tables A pointer to the memory area where the tables will be placed
+ * \param tablesSize The size of the area (in count of align_t)
+ */
+void heapInitTables(align_t* tables, size_t tablesSize);
+
+/**
+ * This method allocates a block of memory for the internal tables of the VM. The block is
+ * zero-initialized and taken from the memory passed to heapInitTables(), not from the heap; it is
+ * freed when the VM is reset. Running out of memory is fatal; see thinjvm.h for the size needed.
+ * \param size The size of the block in bytes
+ * \return A pointer to the block
+ */
+void* heapAllocPermanent(size_t size);
+
 void validateStackables(stackable* memory, size_t length);
 
 #endif /* HEAP_H_ */
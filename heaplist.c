@@ -18,7 +18,34 @@ static header_t* heap;
 // The size of the heap in count of sizeof(align_t):
 static size_t heap_size;
 
-static header_t* free_list;
+/**
+ * The free elements are kept in segregated lists, one per size class. The sizes below
+ * NUMBER_OF_EXACT_SIZE_CLASSES (in align_t, including the header) each have a class of their own, so
+ * any element in such a class fits exactly. Above that each class covers a power of two range of
+ * sizes. The list of a class is unordered.
+ */
+#define NUMBER_OF_EXACT_SIZE_CLASSES 32
+#define NUMBER_OF_SIZE_CLASSES (NUMBER_OF_EXACT_SIZE_CLASSES + 32)
+#define NUMBER_OF_CLASS_BITMAP_WORDS (NUMBER_OF_SIZE_CLASSES / 32)
+
+static header_t* free_lists[NUMBER_OF_SIZE_CLASSES];
+
+// Bit i is set, if free_lists[i] is non-empty:
+static u4 nonEmptyClasses[NUMBER_OF_CLASS_BITMAP_WORDS];
+
+// The total size of the free elements in the free lists (in number of align_t):
+static size_t free_size;
+
+/**
+ * The garbage is swept lazily; see heap_sweep_lazily(). While sweeping, the used elements from
+ * sweep_offset on with mark != sweep_mark_value are garbage. The free lists hold the free elements
+ * below sweep_offset only; the elements from sweep_offset on are left as they were, when the sweep
+ * started. The size of the free elements not swept yet is unswept_free_size.
+ */
+static int sweeping;
+static size_t unswept_free_size;
+static unsigned int sweep_mark_value;
+static size_t sweep_offset;
 
 static header_t* to_header(align_t* a) {
 	return (header_t*) a;
@@ -73,11 +100,196 @@ static void init_element(header_t *h, size_t length, hdrtype_t hdrtyp) {
 	h->e.size = length;
 }
 
+/**
+ * This method initialises a free element. Only the header is cleared; the contents are cleared by
+ * init_element() when the element is allocated.
+ * \param h The element to initialise
+ * \param length The size of the element (in number of header_t, not bytes)
+ */
+static void init_free_element(header_t *h, size_t length) {
+	memset(h, 0, sizeof(header_t));
+	set_type(h, HT_FREE);
+	h->e.size = length;
+}
+
+/**
+ * This method returns the size class of an element
+ * \param size The size of the element (in number of align_t, including the header)
+ * \return The size class
+ */
+static int sGetSizeClass(size_t size) {
+	if (size < NUMBER_OF_EXACT_SIZE_CLASSES) {
+		return (int) size;
+	} else {
+		// Size class NUMBER_OF_EXACT_SIZE_CLASSES covers [32;64[, the next one [64;128[ etc.:
+		int log2 = 31 - __builtin_clz((unsigned int) size);
+		return NUMBER_OF_EXACT_SIZE_CLASSES + log2 - 5;
+	}
+}
+
+/**
+ * This method returns the first non-empty size class >= sizeClass
+ * \param sizeClass The size class to start searching from
+ * \return The size class, or -1 if all size classes >= sizeClass are empty
+ */
+static int sFindNonEmptyClass(int sizeClass) {
+	int word = sizeClass >> 5;
+	u4 bits = nonEmptyClasses[word] & (~(u4) 0 << (sizeClass & 31));
+
+	while (bits == 0) {
+		word++;
+		if (word == NUMBER_OF_CLASS_BITMAP_WORDS) {
+			return -1;
+		}
+		bits = nonEmptyClasses[word];
+	}
+
+	return (word << 5) + __builtin_ctz(bits);
+}
+
+/**
+ * This method inserts a free element into the list of its size class
+ * \param h The free element
+ */
+static void sPushFree(header_t* h) {
+	int sizeClass = sGetSizeClass(h->e.size);
+
+	h->e.next = free_lists[sizeClass];
+	free_lists[sizeClass] = h;
+	nonEmptyClasses[sizeClass >> 5] |= 1u << (sizeClass & 31);
+}
+
+/**
+ * This method removes a free element from the list of its size class
+ * \param sizeClass The size class of h
+ * \param prev The element before h in the list, or NULL if h is the first element
+ * \param h The element to remove
+ */
+static void sUnlinkFree(int sizeClass, header_t* prev, header_t* h) {
+	if (prev == NULL) {
+		free_lists[sizeClass] = h->e.next;
+		if (free_lists[sizeClass] == NULL) {
+			nonEmptyClasses[sizeClass >> 5] &= ~(1u << (sizeClass & 31));
+		}
+	} else {
+		prev->e.next = h->e.next;
+	}
+	h->e.next = NULL;
+}
+
+/**
+ * \return != 0, if h is garbage not swept yet
+ */
+static int is_garbage(header_t* h) {
+	return sweeping && (align_t*) h >= (align_t*) heap + sweep_offset && is_type(h, HT_USED)
+			&& h->e.mark != sweep_mark_value;
+}
+
+/**
+ * This method continues the lazy sweep, until a free element of at least 'size' align_t has been
+ * made, or the end of the heap has been reached. The garbage is merged with its free neighbours.
+ * None of these are in the free lists yet, so nothing needs to be unlinked.
+ * \param size The size of the element needed (in align_t, including the header)
+ */
+static void sSweepStep(size_t size) {
+	// The element being merged with the garbage and free elements following it, if any:
+	header_t* run = NULL;
+
+	while (sweep_offset < heap_size) {
+		header_t* h = offset_header(heap, sweep_offset);
+		// Before advancing; is_garbage() tests against sweep_offset:
+		int isFree = is_type(h, HT_FREE);
+		int isGarbage = is_garbage(h);
+		sweep_offset += h->e.size;
+
+		if (isFree || isGarbage) {
+			if (isFree) {
+				unswept_free_size -= h->e.size;
+			}
+			if (run == NULL) {
+				run = h;
+			} else {
+				// Merge h with run:
+				run->e.size += h->e.size;
+			}
+		} else if (run != NULL) {
+			init_free_element(run, run->e.size);
+			free_size += run->e.size;
+			sPushFree(run);
+			if (run->e.size >= size) {
+				return;
+			}
+			run = NULL;
+		}
+	}
+
+	if (run != NULL) {
+		init_free_element(run, run->e.size);
+		free_size += run->e.size;
+		sPushFree(run);
+	}
+	sweeping = 0;
+}
+
+/**
+ * This method rebuilds the free lists by traversing the heap in address order. Adjacent free
+ * elements are merged. If sweep is != 0, used elements with a mark != markValue are freed as well.
+ * The garbage not swept yet by a lazy sweep is freed in any case, finishing the lazy sweep.
+ * \param sweep != 0, if garbage shall be freed
+ * \param markValue The current mark value to test against; only used if sweep != 0
+ */
+static void sRebuildFreeLists(int sweep, unsigned int markValue) {
+	memset(free_lists, 0, sizeof(free_lists));
+	memset(nonEmptyClasses, 0, sizeof(nonEmptyClasses));
+	free_size = 0;
+	unswept_free_size = 0;
+
+	size_t offset = 0;
+	// The free element being merged with its free neighbours, if any:
+	header_t* previous = NULL;
+
+	while (offset < heap_size) {
+		header_t* h = offset_header(heap, offset);
+		offset += h->e.size;
+
+		if (is_type(h, HT_FREE) || is_garbage(h)
+				|| (sweep && is_type(h, HT_USED) && h->e.mark != markValue)) {
+			if (previous != NULL) {
+				// Merge h with previous:
+				previous->e.size += h->e.size;
+			} else {
+				set_type(h, HT_FREE);
+				previous = h;
+			}
+		} else if (is_type(h, HT_USED) || is_type(h, HT_PROTECTED)) {
+			if (previous != NULL) {
+				free_size += previous->e.size;
+				sPushFree(previous);
+				previous = NULL;
+			}
+		} else {
+			consout("Heap corrupted (magic)\n");
+			HEAP_EXIT;
+		}
+	}
+
+	if (previous != NULL) {
+		free_size += previous->e.size;
+		sPushFree(previous);
+	}
+	sweeping = 0;
+}
+
 void heap_init(align_t* memory, size_t length) {
 	heap = to_header(memory);
 	heap_size = length;
 	init_element(heap, length, HT_FREE);
-	free_list = heap;
+	memset(free_lists, 0, sizeof(free_lists));
+	memset(nonEmptyClasses, 0, sizeof(nonEmptyClasses));
+	sPushFree(heap);
+	free_size = length;
+	unswept_free_size = 0;
+	sweeping = 0;
 
 	HEAP_VALIDATE;
 }
@@ -113,12 +325,17 @@ void heap_validate(const char* file, const int lineno) {
 		heap_exit(file, lineno);
 	}
 
-	// Validate free list:
-	if (free_list != NULL) {
-		header_t* h = free_list;
-		header_t* prev = NULL;
+	// Validate free lists:
+	int sizeClass;
+	for (sizeClass = 0; sizeClass < NUMBER_OF_SIZE_CLASSES; sizeClass++) {
+		header_t* h = free_lists[sizeClass];
+		int nonEmpty = (nonEmptyClasses[sizeClass >> 5] >> (sizeClass & 31)) & 1;
+
+		if (nonEmpty != (h != NULL)) {
+			consout("Heap corrupted (free class bitmap)\n");
+			heap_exit(file, lineno);
+		}
 
-		free_l = 0;
 		while (h != NULL) {
 			if (is_type(h, HT_FREE)) {
 				free_l += h->e.size;
@@ -126,16 +343,19 @@ void heap_validate(const char* file, const int lineno) {
 				consout("Heap corrupted (free magic)\n");
 				heap_exit(file, lineno);
 			}
-			if (prev != NULL && h < prev) {
-				consout("Heap corrupted (free list order)\n");
+			if (sGetSizeClass(h->e.size) != sizeClass) {
+				consout("Heap corrupted (free size class)\n");
+				heap_exit(file, lineno);
+			}
+			if (sweeping && (align_t*) h >= (align_t*) heap + sweep_offset) {
+				consout("Heap corrupted (free element not swept)\n");
 				heap_exit(file, lineno);
 			}
-			prev = h;
 			h = h->e.next;
 		}
 	}
 
-	if (free_l != free_m) {
+	if (free_l != free_size || free_size + unswept_free_size != free_m) {
 		consout("Heap corrupted (free size)\n");
 		heap_exit(file, lineno);
 	}
@@ -144,58 +364,47 @@ void heap_validate(const char* file, const int lineno) {
 void heap_sweep(unsigned int markValue) {
 	HEAP_VALIDATE;
 
-	// TODO Clear free list and rebuild during this sweep ?
+	// The free lists are rebuilt during the sweep; garbage is merged with its free neighbours:
+	sRebuildFreeLists(1, markValue);
 
-	header_t* h = heap;
-	size_t offset = 0;
-	// previous is != NULL, if the previous was free entry:
-	header_t* previous = NULL;
+	HEAP_VALIDATE;
+}
 
-	while (offset < heap_size) {
-		h = offset_header(heap, offset);
-		if (is_type(h, HT_FREE)) {
-			previous = h;
-			offset += h->e.size;
-		} else if (is_type(h, HT_USED)) {
-			if (h->e.mark != markValue) {
-				//--------------------------
-				// Garbage collect this one:
-				//--------------------------
-				size_t previousSize = 0;
-				if (previous != NULL) {
-					// h shall be merged with previous, remember the size of previous:
-					previousSize = previous->e.size;
-				}
-
-				//				consout("Collecting %p (%d)\n", h, (int)h->e.classId);
-				// This call might merge with previous and next element on heap:
-				heap_free(h);
-
-				if (previous != NULL) {
-					// h might have been merged with previous; don't count previous size twice
-					// (previous->e.size might have been increased with the size of h during the merge):
-					offset += previous->e.size - previousSize;
-					// don't change previous
-				} else {
-					offset += h->e.size;
-					previous = h;
-				}
-			} else {
-				offset += h->e.size;
-				previous = NULL;
-			}
-		} else if (is_type(h, HT_PROTECTED)) {
-			previous = NULL;
-			offset += h->e.size;
-		} else {
-			consout("Heap corrupted (magic)\n");
-			HEAP_EXIT;
-		}
-	}
+void heap_sweep_lazily(unsigned int markValue) {
+	heap_sweep_finish();
+	HEAP_VALIDATE;
+
+	sweeping = 1;
+	sweep_mark_value = markValue;
+	sweep_offset = 0;
+
+	// The free elements are listed again, when swept:
+	memset(free_lists, 0, sizeof(free_lists));
+	memset(nonEmptyClasses, 0, sizeof(nonEmptyClasses));
+	unswept_free_size = free_size;
+	free_size = 0;
 
 	HEAP_VALIDATE;
 }
 
+void heap_sweep_step(size_t size) {
+	if (sweeping) {
+		sSweepStep((size + sizeof(align_t) - 1) / sizeof(align_t));
+	}
+}
+
+void heap_sweep_finish(void) {
+	if (sweeping) {
+		HEAP_VALIDATE;
+		sRebuildFreeLists(0, 0);
+		HEAP_VALIDATE;
+	}
+}
+
+int heap_is_sweeping(void) {
+	return sweeping;
+}
+
 void heap_free(header_t* h) {
 	HEAP_VALIDATE;
 
@@ -209,69 +418,91 @@ void heap_free(header_t* h) {
 		HEAP_EXIT;
 	}
 
+	// The collector frees by sweeping, so single frees are rare. Finding the neighbours of h takes
+	// a traversal anyway, so the free lists are simply rebuilt. Any lazy sweep is finished as well:
 	set_type(h, HT_FREE);
-	list_insert_ordered(&free_list, h);
+	sRebuildFreeLists(0, 0);
 
 	HEAP_VALIDATE;
 }
 
-header_t* heap_alloc(size_t size) {
-	header_t* h = free_list;
-	header_t* best_fit = NULL;
-	header_t* prev_best_fit = NULL;
+/**
+ * This method allocates an element from the free lists
+ * \param size The size of the element (in number of align_t, including the header)
+ * \return The allocated element, or NULL if no free element is large enough
+ */
+static header_t* sAllocFree(size_t size) {
+	header_t* fit = NULL;
 	header_t* prev = NULL;
 
-	HEAP_VALIDATE;
-
-	// Also allocate mem for header:
-	size += HEAP_HEADER_SIZE;
+	int sizeClass = sGetSizeClass(size);
+	if (sizeClass >= NUMBER_OF_EXACT_SIZE_CLASSES) {
+		// The elements in the size class of a large request aren't necessarily large enough; take the
+		// first one, which is:
+		fit = free_lists[sizeClass];
+		while (fit != NULL && fit->e.size < size) {
+			prev = fit;
+			fit = fit->e.next;
+		}
+		if (fit == NULL) {
+			sizeClass++;
+		}
+	}
 
-	// Find best candidate:
-	while (h != NULL) {
-		if (h->e.size >= size) {
-			// h fulfils the request, but is it the best:
-			if (best_fit != NULL) {
-				if (h->e.size < best_fit->e.size) {
-					prev_best_fit = prev;
-					best_fit = h;
-				}
-			} else {
-				prev_best_fit = prev;
-				best_fit = h;
-			}
+	if (fit == NULL && sizeClass < NUMBER_OF_SIZE_CLASSES) {
+		// Any element in the first non-empty size class from here fits:
+		prev = NULL;
+		sizeClass = sFindNonEmptyClass(sizeClass);
+		if (sizeClass >= 0) {
+			fit = free_lists[sizeClass];
 		}
-		prev = h;
-		h = h->e.next;
 	}
 
-	if (best_fit != NULL) {
+	if (fit != NULL) {
 		// remove from free list:
-		list_remove(&free_list, prev_best_fit, best_fit);
+		sUnlinkFree(sizeClass, prev, fit);
 
-		size_t remaining_size = best_fit->e.size - size;
-		size_t best_fit_size;
+		size_t remaining_size = fit->e.size - size;
+		size_t fit_size;
 
 		if (remaining_size > HEAP_HEADER_SIZE) {
-			// The best_fit is too large; split into two parts:
-			header_t* remaining = offset_header(best_fit, size);
-			init_element(remaining, remaining_size, HT_FREE);
+			// The fit is too large; split into two parts:
+			header_t* remaining = offset_header(fit, size);
+			init_free_element(remaining, remaining_size);
 
 			// Return to free list:
-			list_insert_ordered(&free_list, remaining);
+			sPushFree(remaining);
 
-			// Adjust the size of best fit:
-			best_fit_size = size;
+			// Adjust the size of fit:
+			fit_size = size;
 		} else {
 			// No split:
-			best_fit_size = best_fit->e.size;
+			fit_size = fit->e.size;
 		}
 		// else: Perfect fit
-		init_element(best_fit, best_fit_size, HT_USED);
+		init_element(fit, fit_size, HT_USED);
+		free_size -= fit_size;
+	}
+
+	return fit;
+}
+
+header_t* heap_alloc(size_t size) {
+	HEAP_VALIDATE;
+
+	// Also allocate mem for header:
+	size += HEAP_HEADER_SIZE;
+
+	header_t* fit = sAllocFree(size);
+	while (fit == NULL && sweeping) {
+		sSweepStep(size);
+		fit = sAllocFree(size);
 	}
+
 	// else: Out of mem
 	HEAP_VALIDATE;
 
-	return best_fit;
+	return fit;
 }
 
 void heap_exit(const char* file, const int lineno) {
@@ -327,6 +558,110 @@ int heap_max() {
 	return heap_size * sizeof(align_t);
 }
 
+size_t heap_free_bytes() {
+	return (free_size + unswept_free_size) * sizeof(align_t);
+}
+
+size_t heap_largest_free_bytes() {
+	size_t largest = 0;
+
+	// The largest element is in the last non-empty size class:
+	int sizeClass;
+	for (sizeClass = NUMBER_OF_SIZE_CLASSES - 1; sizeClass >= 0 && largest == 0; sizeClass--) {
+		header_t* h = free_lists[sizeClass];
+		while (h != NULL) {
+			if (h->e.size > largest) {
+				largest = h->e.size;
+			}
+			h = h->e.next;
+		}
+	}
+
+	return largest * sizeof(align_t);
+}
+
+/**
+ * \return != 0, if the used element h shall not be moved by heap_compact()
+ */
+static int is_pinned(header_t* h) {
+	return is_type(h, HT_PROTECTED) || h->e.pinned;
+}
+
+void heap_set_forwarding(unsigned int markValue) {
+	HEAP_VALIDATE;
+
+	// The offset, where the next live element will be moved to:
+	size_t to = 0;
+
+	size_t offset = 0;
+	while (offset < heap_size) {
+		header_t* h = offset_header(heap, offset);
+
+		if (is_type(h, HT_PROTECTED) || (is_type(h, HT_USED) && h->e.mark == markValue)) {
+			if (is_pinned(h)) {
+				// The elements before h are moved to the gap before h:
+				to = offset;
+			}
+			h->e.next = offset_header(heap, to);
+			to += h->e.size;
+		} else if (is_type(h, HT_USED)) {
+			// Garbage:
+			h->e.next = NULL;
+		}
+		// else: Free; the free lists are kept intact until heap_compact()
+
+		offset += h->e.size;
+	}
+}
+
+void heap_compact() {
+	// The end of the last element moved (or not moved, if pinned):
+	size_t top = 0;
+
+	size_t offset = 0;
+	while (offset < heap_size) {
+		header_t* h = offset_header(heap, offset);
+		size_t size = h->e.size;
+
+		if ((is_type(h, HT_USED) || is_type(h, HT_PROTECTED)) && h->e.next != NULL) {
+			header_t* to = h->e.next;
+			h->e.next = NULL;
+
+			if (to == h && offset > top) {
+				// Pinned; the gap in front of h is free:
+				init_free_element(offset_header(heap, top), offset - top);
+			} else if (to != h) {
+				memmove(to, h, size * sizeof(align_t));
+			}
+			top = (align_t*) to - (align_t*) heap + size;
+		}
+
+		offset += size;
+	}
+
+	if (top < heap_size) {
+		init_free_element(offset_header(heap, top), heap_size - top);
+	}
+
+	// The gaps and the garbage are merged into free elements:
+	sRebuildFreeLists(0, 0);
+
+	HEAP_VALIDATE;
+}
+
+void heap_for_each_used(void (*visit)(header_t* h)) {
+	size_t offset = 0;
+	while (offset < heap_size) {
+		header_t* h = offset_header(heap, offset);
+
+		// Read the size first; visit might allocate and thereby split a free element following h:
+		offset += h->e.size;
+		if ((is_type(h, HT_USED) && !is_garbage(h)) || is_type(h, HT_PROTECTED)) {
+			visit(h);
+		}
+	}
+}
+
 static void sDumpObject(header_t* h) {
 	if (0 <= h->e.classId && h->e.classId < numberOfAllClassInstanceInfo) {
 		if (isObjectArray(h->e.classId)) {
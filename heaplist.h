@@ -70,6 +70,32 @@ void heap_dump(void);
  */
 void heap_sweep(unsigned int markValue);
 
+/**
+ * This function starts a lazy sweep: The used elements having a mark != markValue are removed by
+ * heap_alloc(), when no free element is large enough, and only as far as needed. The sweep
+ * proceeds in address order; the free elements are available for allocation, when swept. The
+ * mark values of the elements not swept yet shall not be changed until the sweep has finished.
+ * \param markValue The current mark value to test against.
+ */
+void heap_sweep_lazily(unsigned int markValue);
+
+/**
+ * This function continues a lazy sweep, if any, until a free element of at least 'size' bytes
+ * has been made, or the sweep has finished.
+ * \param size The size of the element needed in bytes, including the header
+ */
+void heap_sweep_step(size_t size);
+
+/**
+ * This function sweeps the rest of the heap, if a lazy sweep is in progress
+ */
+void heap_sweep_finish(void);
+
+/**
+ * \return != 0, if a lazy sweep is in progress
+ */
+int heap_is_sweeping(void);
+
 /**
  * This function prints src file and line number and exits.
  * \param file The name of the calling file
@@ -90,6 +116,43 @@ int heap_used();
  */
 int heap_max();
 
+/**
+ * This function returns the number of free bytes on heap. The free memory might be fragmented.
+ * The garbage not swept yet by a lazy sweep isn't included.
+ * \return The number of free bytes on heap
+ */
+size_t heap_free_bytes(void);
+
+/**
+ * This function returns the size of the largest free element on heap
+ * \return The size of the largest free element in bytes, including the header
+ */
+size_t heap_largest_free_bytes(void);
+
+/**
+ * This function computes the addresses, that the live elements are moved to by heap_compact().
+ * The address is stored in e.next; e.next is set to NULL for garbage elements. Live
+ * elements are the protected elements and the used elements having mark == markValue. The
+ * protected elements and the elements with the pinned flag set aren't moved.
+ * \param markValue The current mark value
+ */
+void heap_set_forwarding(unsigned int markValue);
+
+/**
+ * This function slides the live elements to the addresses computed by heap_set_forwarding(). The
+ * references to the elements shall be updated before calling this function. Afterwards the free
+ * memory between the pinned elements is contiguous.
+ */
+void heap_compact(void);
+
+/**
+ * This function calls visit for each used (or protected) element on the heap, in address order.
+ * The garbage not swept yet by a lazy sweep is skipped. visit may allocate elements; these might
+ * be visited as well.
+ * \param visit The function to call
+ */
+void heap_for_each_used(void (*visit)(header_t* h));
+
 
 //------------------------------------------------------------------
 // type field access
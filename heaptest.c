@@ -6,7 +6,15 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 #include "heaplist.h"
+#include "heap.h"
+#include "frame.h"
+#include "jni.h"
+#include "jarray.h"
+#include "constantpool.h"
+#include "objectaccess.h"
+#include "vmids.h"
 
 #define MEMSIZE 200
 static align_t heapmem[MEMSIZE];
@@ -50,6 +58,216 @@ void testRandom(int* ia) {
 	}
 }
 
+/**
+ * This method fills the payload of an element with a byte pattern
+ */
+static void fill(header_t* h, int pattern) {
+	memset((align_t*) h + HEAP_HEADER_SIZE, pattern, (h->e.size - HEAP_HEADER_SIZE) * sizeof(align_t));
+}
+
+/**
+ * \return != 0, if the payload of the element h is filled with pattern
+ */
+static int hasPattern(header_t* h, int pattern) {
+	u1* p = (u1*) ((align_t*) h + HEAP_HEADER_SIZE);
+	size_t length = (h->e.size - HEAP_HEADER_SIZE) * sizeof(align_t);
+	size_t i;
+	for (i = 0; i < length; i++) {
+		if (p[i] != (u1) pattern) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/**
+ * This method verifies the free memory; the size class lists and their bitmap are validated too
+ * \param freeSize The expected number of free align_t, the unswept free elements included
+ * \param largest The expected size of the largest free element in the free lists, in align_t
+ */
+static void verifyFree(const char* file, const int line, size_t freeSize, size_t largest) {
+	heap_validate(file, line);
+	verify(file, line, heap_free_bytes() == freeSize * sizeof(align_t));
+	verify(file, line, heap_largest_free_bytes() == largest * sizeof(align_t));
+}
+
+#define VERIFY_FREE(F, L) verifyFree(__FILE__, __LINE__, F, L)
+
+void testSplitAndMerge() {
+	heap_init(&heapmem[0], MEMSIZE);
+	VERIFY_FREE(MEMSIZE, MEMSIZE);
+
+	header_t* p1 = heap_alloc(10);
+	header_t* p2 = heap_alloc(40);
+	header_t* p3 = heap_alloc(10);
+	size_t used = 60 + 3 * HEAP_HEADER_SIZE;
+	VERIFY_FREE(MEMSIZE - used, MEMSIZE - used);
+
+	// A free element in an exact size class:
+	heap_free(p1);
+	VERIFY_FREE(MEMSIZE - used + p1->e.size, MEMSIZE - used);
+
+	// ... fits exactly:
+	VERIFY(heap_alloc(10) == p1);
+	VERIFY_FREE(MEMSIZE - used, MEMSIZE - used);
+
+	// A free element in a size class covering a range of sizes is split:
+	size_t p2Size = p2->e.size;
+	heap_free(p2);
+	VERIFY_FREE(MEMSIZE - used + p2Size, MEMSIZE - used);
+	header_t* p4 = heap_alloc(20);
+	VERIFY(p4 == p2);
+	VERIFY(p4->e.size == 20 + HEAP_HEADER_SIZE);
+	header_t* rest = offset_header(p4, p4->e.size);
+	VERIFY(is_type(rest, HT_FREE) && rest->e.size == p2Size - p4->e.size);
+	VERIFY_FREE(MEMSIZE - used + rest->e.size, MEMSIZE - used);
+
+	// The remainder is merged with its free neighbours:
+	heap_free(p4);
+	VERIFY_FREE(MEMSIZE - used + p2Size, MEMSIZE - used);
+	heap_free(p3);
+	VERIFY_FREE(MEMSIZE - p1->e.size, MEMSIZE - p1->e.size);
+	heap_free(p1);
+	VERIFY_FREE(MEMSIZE, MEMSIZE);
+}
+
+void testCompact() {
+	heap_init(&heapmem[0], MEMSIZE);
+
+	const unsigned int markValue = 1;
+
+	// a, pinned, b, protected and c are live; g1, g2 and g3 are garbage:
+	header_t* a = heap_alloc(10);
+	header_t* g1 = heap_alloc(12);
+	header_t* pinned = heap_alloc(5);
+	header_t* g2 = heap_alloc(7);
+	header_t* b = heap_alloc(10);
+	header_t* g3 = heap_alloc(9);
+	header_t* protected = heap_alloc(5);
+	header_t* c = heap_alloc(10);
+
+	header_t* live[] = { a, pinned, b, protected, c };
+	size_t liveSize = 0;
+	int i;
+	for (i = 0; i < sizeof(live) / sizeof(live[0]); i++) {
+		live[i]->e.mark = markValue;
+		fill(live[i], 'a' + i);
+		liveSize += live[i]->e.size;
+	}
+	fill(g1, 'x');
+	fill(g2, 'x');
+	fill(g3, 'x');
+	pinned->e.pinned = 1;
+	set_type(protected, HT_PROTECTED);
+	size_t gapSize = g2->e.size + g3->e.size;
+
+	heap_set_forwarding(markValue);
+	header_t* bTo = offset_header(pinned, pinned->e.size);
+	header_t* cTo = offset_header(protected, protected->e.size);
+	VERIFY(a->e.next == a);
+	VERIFY(pinned->e.next == pinned);
+	VERIFY(b->e.next == bTo);
+	VERIFY(protected->e.next == protected);
+	VERIFY(c->e.next == cTo);
+	VERIFY(g1->e.next == NULL && g2->e.next == NULL && g3->e.next == NULL);
+
+	heap_compact();
+
+	// The elements not moved:
+	VERIFY(is_type(a, HT_USED) && hasPattern(a, 'a'));
+	VERIFY(is_type(pinned, HT_USED) && hasPattern(pinned, 'b'));
+	VERIFY(is_type(protected, HT_PROTECTED) && hasPattern(protected, 'd'));
+
+	// The gap before the pinned element:
+	VERIFY(is_type(g1, HT_FREE) && g1->e.size == 12 + HEAP_HEADER_SIZE);
+
+	// b slides to the pinned element; the gap before the protected element is free:
+	VERIFY(is_type(bTo, HT_USED) && bTo->e.size == 10 + HEAP_HEADER_SIZE && hasPattern(bTo, 'c'));
+	header_t* gap = offset_header(bTo, bTo->e.size);
+	VERIFY(is_type(gap, HT_FREE));
+	VERIFY(gap->e.size == gapSize);
+	VERIFY(offset_header(gap, gap->e.size) == protected);
+
+	// c slides to the protected element, and the free memory after it is contiguous:
+	VERIFY(is_type(cTo, HT_USED) && cTo->e.size == 10 + HEAP_HEADER_SIZE && hasPattern(cTo, 'e'));
+	header_t* top = offset_header(cTo, cTo->e.size);
+	VERIFY(is_type(top, HT_FREE) && (align_t*) top + top->e.size == heapmem + MEMSIZE);
+	VERIFY_FREE(MEMSIZE - liveSize, top->e.size);
+}
+
+static int visited;
+
+static void countVisit(header_t* h) {
+	visited++;
+}
+
+static int countUsed() {
+	visited = 0;
+	heap_for_each_used(countVisit);
+	return visited;
+}
+
+void testLazySweep() {
+	heap_init(&heapmem[0], MEMSIZE);
+
+	const unsigned int markValue = 1;
+
+	// x1, x2 and x3 are live; g1, g2 and g3 are garbage:
+	header_t* x1 = heap_alloc(10);
+	header_t* g1 = heap_alloc(10);
+	header_t* g2 = heap_alloc(10);
+	header_t* x2 = heap_alloc(10);
+	header_t* g3 = heap_alloc(30);
+	header_t* x3 = heap_alloc(10);
+	x1->e.mark = markValue;
+	x2->e.mark = markValue;
+	x3->e.mark = markValue;
+	fill(x1, 1);
+	fill(x2, 2);
+	fill(x3, 3);
+	size_t tail = MEMSIZE - ((align_t*) x3 - heapmem) - x3->e.size;
+	size_t g12Size = g1->e.size + g2->e.size;
+	size_t g3Size = g3->e.size;
+
+	// Nothing is swept yet; the free element at the end is counted, but not in the free lists:
+	heap_sweep_lazily(markValue);
+	VERIFY(heap_is_sweeping());
+	VERIFY_FREE(tail, 0);
+	VERIFY(countUsed() == 3);
+
+	// g1 and g2 are merged, and the allocation is split from them:
+	header_t* n1 = heap_alloc(5);
+	VERIFY(n1 == g1);
+	VERIFY(heap_is_sweeping());
+	VERIFY_FREE(tail + g12Size - n1->e.size, g12Size - n1->e.size);
+	VERIFY(countUsed() == 4);
+
+	// The remainder is too small; g3 is swept:
+	header_t* n2 = heap_alloc(25);
+	VERIFY(n2 == g3);
+	VERIFY(heap_is_sweeping());
+	VERIFY_FREE(tail + g12Size - n1->e.size + g3Size - n2->e.size, g12Size - n1->e.size);
+	VERIFY(countUsed() == 5);
+
+	// An element allocated while sweeping isn't garbage, though its mark != markValue:
+	heap_sweep_finish();
+	VERIFY(!heap_is_sweeping());
+	VERIFY(is_type(n1, HT_USED) && is_type(n2, HT_USED));
+	VERIFY_FREE(tail + g12Size - n1->e.size + g3Size - n2->e.size, tail);
+	VERIFY(countUsed() == 5);
+	VERIFY(hasPattern(x1, 1) && hasPattern(x2, 2) && hasPattern(x3, 3));
+
+	// A lazy sweep is finished by heap_free():
+	heap_sweep_lazily(markValue);
+	VERIFY(countUsed() == 3);
+	size_t middle = n1->e.size + (g12Size - n1->e.size) + x2->e.size + n2->e.size;
+	heap_free(x2);
+	VERIFY(!heap_is_sweeping());
+	VERIFY(countUsed() == 2);
+	VERIFY(is_type(g1, HT_FREE) && g1->e.size == middle);
+	VERIFY_FREE(MEMSIZE - x1->e.size - x3->e.size, middle > tail ? middle : tail);
+}
+
 int heap_test() {
 	heap_init(&heapmem[0], MEMSIZE);
 
@@ -131,7 +349,354 @@ int heap_test() {
 	testRandom(ia8);
 	testRandom(ia9);
 
+	testSplitAndMerge();
+	testCompact();
+	testLazySweep();
+
 	printf("End of Test\n");
 
 	return 0;
 }
+
+/**
+ * The tests below run on a VM reset on a heap of its own. No Java code is executed, so the
+ * operand stack, the static memory and the interned strings are the only roots.
+ */
+
+/**
+ * \return A new byte[] filled with pattern
+ */
+static jbyteArray newBytes(size_t len, int pattern) {
+	jbyteArray array = NewByteArray(len);
+	memset(jaGetArrayPayLoad(array), pattern, len);
+	return array;
+}
+
+/**
+ * \return != 0, if the byte[] has the length len and is filled with pattern
+ */
+static int hasBytes(jbyteArray array, size_t len, int pattern) {
+	if (GetArrayLength(array) != len) {
+		return 0;
+	}
+
+	u1* p = (u1*) jaGetArrayPayLoad(array);
+	size_t i;
+	for (i = 0; i < len; i++) {
+		if (p[i] != (u1) pattern) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/**
+ * \return The reference at the position 'index' of the operand stack
+ */
+static jobject getRoot(int index) {
+	return getStack()[index].operand.jref;
+}
+
+static void setRoot(int index, jobject obj) {
+	getStack()[index].operand.jref = obj;
+}
+
+void testCompactObjectGraph() {
+	int base = context.stackPointer;
+
+	// G1, A and G2 are promoted in this order; G1 and G2 become garbage:
+	operandStackPushObjectRef(newBytes(40, 'x'));
+	operandStackPushObjectRef(NewObjectArray(2, JAVA_LANG_OBJECT_CLASS_ID, NULL));
+	operandStackPushObjectRef(newBytes(40, 'x'));
+	heapScavenge();
+
+	// Then the pinned element P:
+	jbyteArray pinned = jaNewTenuredByteArray(40);
+	memset(jaGetArrayPayLoad(pinned), 'p', 40);
+	operandStackPushObjectRef(pinned);
+
+	// ... and G3 and B:
+	operandStackPushObjectRef(newBytes(40, 'x'));
+	operandStackPushObjectRef(NewObjectArray(2, JAVA_LANG_OBJECT_CLASS_ID, NULL));
+	heapScavenge();
+
+	// Y stays in the nursery:
+	operandStackPushObjectRef(newBytes(40, 'y'));
+
+	jobjectArray a = getRoot(base + 1);
+	jobjectArray b = getRoot(base + 5);
+	jbyteArray y = getRoot(base + 6);
+	VERIFY((align_t*) a < (align_t*) pinned && (align_t*) pinned < (align_t*) b);
+
+	// A -> B and P, B -> A and Y; B is remembered:
+	SetObjectArrayElement(a, 0, b);
+	SetObjectArrayElement(a, 1, pinned);
+	SetObjectArrayElement(b, 0, a);
+	SetObjectArrayElement(b, 1, y);
+
+	// A is referenced from the stack, B from the interned strings:
+	VERIFY(numberOfAllStringConstantReferences > 0);
+	internedStrings[0].operand.jref = b;
+	int i;
+	for (i = base; i < base + 7; i++) {
+		if (i != base + 1) {
+			setRoot(i, NULL);
+		}
+	}
+
+	size_t numberOfClasses = GetArrayLength(javaLangClassArray);
+	heapCompact();
+
+	// A and B have slid towards the start of the old space; G1 and G3 are gone:
+	VERIFY((align_t*) getRoot(base + 1) < (align_t*) a);
+	a = getRoot(base + 1);
+	VERIFY(GetArrayLength(a) == 2);
+	VERIFY((align_t*) GetObjectArrayElement(a, 0) < (align_t*) b);
+	b = GetObjectArrayElement(a, 0);
+	VERIFY(GetArrayLength(b) == 2);
+	VERIFY(internedStrings[0].operand.jref == b);
+	VERIFY(GetObjectArrayElement(b, 0) == a);
+
+	// P and Y haven't moved:
+	VERIFY(GetObjectArrayElement(a, 1) == pinned);
+	VERIFY(hasBytes(pinned, 40, 'p'));
+	VERIFY(GetObjectArrayElement(b, 1) == y);
+	VERIFY(hasBytes(y, 40, 'y'));
+
+	// The Class[] is referenced from java.lang.Class as well:
+	VERIFY(javaLangClassArray != NULL && GetArrayLength(javaLangClassArray) == numberOfClasses);
+	jclass classClass = getJavaLangClass(CLASS_ID_java_lang_Class);
+	VERIFY(GetStaticObjectField(classClass, LINK_ID_java_lang_Class_aAllClasses__Ljava_lang_Class_)
+			== javaLangClassArray);
+	for (i = 0; i < numberOfClasses; i++) {
+		jclass cls = GetObjectArrayElement(javaLangClassArray, i);
+		VERIFY(cls == NULL || getClassIdOfJavaLangClass(cls) == i);
+	}
+
+	// The remembered set refers to B at its new address, so Y is promoted into B:
+	heapScavenge();
+	a = getRoot(base + 1);
+	b = GetObjectArrayElement(a, 0);
+	VERIFY(GetObjectArrayElement(b, 1) != y);
+	VERIFY(hasBytes(GetObjectArrayElement(b, 1), 40, 'y'));
+
+	internedStrings[0].operand.jref = NULL;
+	context.stackPointer = base;
+}
+
+static header_t* sought;
+static int found;
+
+static void findVisit(header_t* h) {
+	if (h == sought) {
+		found = 1;
+	}
+}
+
+/**
+ * \return != 0, if obj is a used element in the old space, i.e. it hasn't been swept
+ */
+static int isInOldSpace(jobject obj) {
+	sought = getHeader(obj);
+	found = 0;
+	heap_for_each_used(findVisit);
+	return found;
+}
+
+/**
+ * This function allocates garbage in the old space, until an incremental marking is started
+ * \param heapSize The size of the heap (in count of align_t)
+ * \param exceptionThrown The exception flag at the safepoints collecting the pending garbage
+ */
+static void startMarking(size_t heapSize, BOOL exceptionThrown) {
+	VERIFY(!heapIsMarking());
+
+	// Too large for the nursery, which is 1/16 of the heap; a single object can take 1/4 of it:
+	size_t len = heapSize / 64 * sizeof(align_t);
+
+	int i;
+	for (i = 0; i < 1000 && !heapIsMarking(); i++) {
+		if (heapIsCollectionPending()) {
+			context.exceptionThrown = exceptionThrown;
+			heapCollectPending();
+			VERIFY(context.exceptionThrown == exceptionThrown);
+			context.exceptionThrown = FALSE;
+		} else {
+			NewByteArray(len);
+		}
+	}
+	VERIFY(heapIsMarking());
+}
+
+/**
+ * This function finishes the incremental marking and sweeps the garbage
+ */
+static void finishMarking() {
+	while (heapIsMarking()) {
+		heapCollectPending();
+	}
+	heap_sweep_finish();
+}
+
+void testSnapshotAtTheBeginning(size_t heapSize) {
+	int base = context.stackPointer;
+
+	// A holds the only reference to X:
+	operandStackPushObjectRef(NewObjectArray(1, JAVA_LANG_OBJECT_CLASS_ID, NULL));
+	jbyteArray x = newBytes(40, 's');
+	SetObjectArrayElement(getRoot(base), 0, x);
+	heapScavenge();
+
+	// A is grey, but not scanned yet:
+	startMarking(heapSize, FALSE);
+	jobjectArray a = getRoot(base);
+	x = GetObjectArrayElement(a, 0);
+	VERIFY(getHeader(x)->e.mark != getHeader(a)->e.mark);
+
+	// X is moved from A to the stack, which has been scanned already:
+	operandStackPushObjectRef(x);
+	SetObjectArrayElement(a, 0, NULL);
+	VERIFY(getHeader(x)->e.mark == getHeader(a)->e.mark);
+
+	finishMarking();
+	x = getRoot(base + 1);
+	VERIFY(isInOldSpace(x));
+	VERIFY(hasBytes(x, 40, 's'));
+
+	context.stackPointer = base;
+}
+
+// More than the grey stack in heap.c can hold:
+#define NUMBER_OF_GREY_OBJECTS 150
+
+void testGreyStackOverflow(size_t heapSize) {
+	int base = context.stackPointer;
+
+	// A references the objects X, so they are all shaded, when A is scanned. Each X references a
+	// byte[], which is lost, if X isn't scanned:
+	operandStackPushObjectRef(NewObjectArray(NUMBER_OF_GREY_OBJECTS, JAVA_LANG_OBJECT_CLASS_ID, NULL));
+	int i;
+	for (i = 0; i < NUMBER_OF_GREY_OBJECTS; i++) {
+		jobjectArray x = NewObjectArray(1, JAVA_LANG_OBJECT_CLASS_ID, NULL);
+		SetObjectArrayElement(getRoot(base), i, x);
+		SetObjectArrayElement(x, 0, newBytes(8, i));
+	}
+	heapScavenge();
+
+	startMarking(heapSize, FALSE);
+	finishMarking();
+
+	jobjectArray a = getRoot(base);
+	VERIFY(isInOldSpace(a));
+	for (i = 0; i < NUMBER_OF_GREY_OBJECTS; i++) {
+		jobjectArray x = GetObjectArrayElement(a, i);
+		jbyteArray y = GetObjectArrayElement(x, 0);
+		VERIFY(isInOldSpace(x) && isInOldSpace(y));
+		VERIFY(hasBytes(y, 8, i));
+	}
+
+	context.stackPointer = base;
+}
+
+// Size of the stack of a suspended thread (in count of stackables):
+#define SUSPENDED_STACK_SIZE 4
+
+/**
+ * This function starts the scheduling of two threads: T1 is the thread running the tests, on the
+ * current stack, while T2 is suspended. The scheduling is stopped by the next VM reset.
+ * \return The stack of T2; the first stackable is on the stack and holds no reference
+ */
+static stackable* startScheduling() {
+	jclass threadClass = getJavaLangClass(CLASS_ID_java_lang_Thread);
+
+	jobject t1 = newObject(CLASS_ID_java_lang_Thread);
+	SetStaticObjectField(threadClass, LINK_ID_java_lang_Thread_aAllThreads_Ljava_lang_Thread_, t1);
+	SetStaticObjectField(threadClass, LINK_ID_java_lang_Thread_aCurrentThread_Ljava_lang_Thread_, t1);
+	SetObjectField(t1, LINK_ID_java_lang_Thread_aStack__B, osGetCurrentStack());
+
+	jobject t2 = newObject(CLASS_ID_java_lang_Thread);
+	SetObjectField(t1, LINK_ID_java_lang_Thread_aNextThread_Ljava_lang_Thread_, t2);
+
+	// The stack and the context of T2 don't move:
+	jbyteArray stack = jaNewTenuredByteArray(SUSPENDED_STACK_SIZE * sizeof(stackable));
+	SetObjectField(t2, LINK_ID_java_lang_Thread_aStack__B, stack);
+	stackable* s = (stackable*) jaGetArrayPayLoad(stack);
+	s[0].operand.jref = NULL;
+	s[0].type = OBJECTREF;
+
+	jbyteArray contextArray = jaNewTenuredByteArray(sizeof(contextDef));
+	SetObjectField(t2, LINK_ID_java_lang_Thread_aContext__B, contextArray);
+	contextDef t2Context = context;
+	t2Context.stackPointer = 1;
+	SetByteArrayRegion(contextArray, 0, sizeof(contextDef), (jbyte*) &t2Context);
+
+	frStartScheduling();
+
+	return s;
+}
+
+void testScavengeWithPendingException() {
+	int base = context.stackPointer;
+	stackable* t2Stack = startScheduling();
+
+	// X is referenced from the stack of T1, Y from the stack of T2:
+	operandStackPushObjectRef(newBytes(40, 'x'));
+	t2Stack[0].operand.jref = newBytes(40, 'y');
+
+	// The last instruction threw an exception; the flag is still set at the safepoint:
+	context.exceptionThrown = TRUE;
+	heapScavenge();
+	VERIFY(context.exceptionThrown);
+	context.exceptionThrown = FALSE;
+
+	VERIFY(isInOldSpace(getRoot(base)) && hasBytes(getRoot(base), 40, 'x'));
+	VERIFY(isInOldSpace(t2Stack[0].operand.jref) && hasBytes(t2Stack[0].operand.jref, 40, 'y'));
+
+	t2Stack[0].operand.jref = NULL;
+	context.stackPointer = base;
+}
+
+void testMarkingWithPendingException(size_t heapSize) {
+	int base = context.stackPointer;
+	stackable* t2Stack = startScheduling();
+
+	// X is referenced from the stack of T1 only, Y from the stack of T2 only:
+	operandStackPushObjectRef(newBytes(40, 'x'));
+	t2Stack[0].operand.jref = newBytes(40, 'y');
+	heapScavenge();
+
+	// The marking starts at a safepoint right after an instruction has thrown an exception; the
+	// stacks are shaded nevertheless:
+	startMarking(heapSize, TRUE);
+	finishMarking();
+
+	VERIFY(isInOldSpace(getRoot(base)) && hasBytes(getRoot(base), 40, 'x'));
+	VERIFY(isInOldSpace(t2Stack[0].operand.jref) && hasBytes(t2Stack[0].operand.jref, 40, 'y'));
+
+	t2Stack[0].operand.jref = NULL;
+	context.stackPointer = base;
+}
+
+/**
+ * This function tests the garbage collector of the VM
+ * \param heap The memory for the heap
+ * \param heapSize The size of the heap (in count of align_t)
+ * \param stackSize The size of the stack in bytes
+ * \param tables The memory for the tables of the VM
+ * \param tablesSize The size of the tables (in count of align_t)
+ */
+int heap_gc_test(align_t* heap, size_t heapSize, size_t stackSize, align_t* tables,
+		size_t tablesSize) {
+	resetVM(heap, heapSize, stackSize, tables, tablesSize);
+
+	testCompactObjectGraph();
+	testSnapshotAtTheBeginning(heapSize);
+	testGreyStackOverflow(heapSize);
+	// Last; the scheduling started by these is stopped by the next reset only:
+	testScavengeWithPendingException();
+	testMarkingWithPendingException(heapSize);
+
+	printf("End of GC Test\n");
+
+	return 0;
+}
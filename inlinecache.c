@@ -0,0 +1,87 @@
+/*
+ * inlinecache.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "types.h"
+#include "config.h"
+#include "constantpool.h"
+#include "exceptions.h"
+#include "frame.h"
+#include "objectaccess.h"
+#include "operandstack.h"
+#include "vtable.h"
+#include "inlinecache.h"
+
+static u4 hits = 0;
+static u4 misses = 0;
+
+void icInit(inlineCache* cache, u2 classId, u2 cp_index) {
+	const memberReference* mref = lookupMethodReference(classId, cp_index);
+
+	cache->linkId = mref->linkId;
+	cache->numberOfArguments = mref->numberOfArguments;
+	cache->size = 0;
+	cache->referencedClassId = mref->referencedClassId;
+	cache->isInterface = getClassType(mref->referencedClassId) == CT_INTERFACE;
+	if (cache->isInterface) {
+		cache->slot = vtGetInterfaceSlot(mref->referencedClassId, mref->linkId);
+	} else {
+		cache->slot = vtGetSlot(mref->referencedClassId, mref->linkId);
+	}
+}
+
+const methodInClass* icGetVirtualMethodEntry(inlineCache* cache) {
+	// Find the object on which the referenced method shall be invoked:
+	stackable* st = &stack[context.stackPointer - cache->numberOfArguments];
+
+	VALIDATE_TYPE(st->type, OBJECTREF);
+
+	jobject jref = st->operand.jref;
+	const methodInClass* mic = NULL;
+	if (jref == NULL) {
+		throwNullPointerException();
+	} else {
+		u2 classId = oaGetClassIdFromObject(jref);
+		int i;
+		for (i = 0; i < cache->size && mic == NULL; i++) {
+			if (cache->classId[i] == classId) {
+				mic = cache->method[i];
+			}
+		}
+
+		if (mic != NULL) {
+			hits++;
+		} else {
+			misses++;
+			if (cache->slot >= 0) {
+				if (cache->isInterface) {
+					mic = vtGetInterfaceMethod(classId, cache->referencedClassId, cache->slot);
+				} else {
+					mic = vtGetMethod(classId, cache->slot);
+				}
+			}
+			if (mic == NULL) {
+				mic = getVirtualMethodEntryByLinkId(jref, cache->linkId);
+			}
+
+			if (cache->size < IC_NUMBER_OF_ENTRIES) {
+				i = cache->size++;
+			} else {
+				// Megamorphic call site; keep the first entries, and let the last one be the most
+				// recent:
+				i = IC_NUMBER_OF_ENTRIES - 1;
+			}
+			cache->classId[i] = classId;
+			cache->method[i] = mic;
+		}
+	}
+
+	return mic;
+}
+
+void icGetStat(icStat* stat) {
+	stat->hits = hits;
+	stat->misses = misses;
+}
@@ -0,0 +1,73 @@
+/*
+ * inlinecache.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef INLINECACHE_H_
+#define INLINECACHE_H_
+
+#include "types.h"
+#include "constantpool.h"
+
+// The number of receiver classes cached per call site; the first entry is the monomorphic case:
+#define IC_NUMBER_OF_ENTRIES 4
+
+/**
+ * The cache of an invokevirtual or invokeinterface call site. The cache maps the class id of the
+ * receiver to the method invoked on it:
+ */
+typedef struct __inlineCache {
+	// The linkId of the invoked method:
+	u2 linkId;
+	// The number of arguments including 'this'; the receiver is found this far below the top of
+	// the stack:
+	u1 numberOfArguments;
+	// The number of entries in use:
+	u1 size;
+	// TRUE, if the referenced class is an interface:
+	u1 isInterface;
+	// The referenced class or interface:
+	u2 referencedClassId;
+	// The vtable slot, or the itable slot if the referenced class is an interface; -1 if unknown:
+	s2 slot;
+	// The class ids of the receivers:
+	u2 classId[IC_NUMBER_OF_ENTRIES];
+	// The method to invoke for each of the class ids:
+	const methodInClass* method[IC_NUMBER_OF_ENTRIES];
+} inlineCache;
+
+/**
+ * This struct contains stat about how the inline caches perform
+ */
+typedef struct __icStat {
+	// The number of lookups found in a cache:
+	u4 hits;
+	// The number of lookups not found in a cache, i.e. resolved by a full lookup:
+	u4 misses;
+} icStat;
+
+/**
+ * This method initializes an empty cache for a call site
+ * \param cache The cache to initialize
+ * \param classId The id of the class containing the call site
+ * \param cp_index The constant pool index of the invoked method
+ */
+void icInit(inlineCache* cache, u2 classId, u2 cp_index);
+
+/**
+ * This method looks up the method to invoke on the receiver found on the stack. The cache is
+ * updated on a miss; a miss is resolved using the vtable or itable of the receiver class.
+ * \param cache The cache of the call site
+ * \return The method to invoke, or NULL if the receiver is null, in which case a NullPointerException
+ * has been thrown
+ */
+const methodInClass* icGetVirtualMethodEntry(inlineCache* cache);
+
+/**
+ * This method returns the hit / miss statistics of all inline caches
+ * \param stat Pointer to where the statistics shall be stored
+ */
+void icGetStat(icStat* stat);
+
+#endif /* INLINECACHE_H_ */
@@ -19,11 +19,16 @@
 #include "jni.h"
 #include "exceptions.h"
 #include "objectaccess.h"
+#include "threadedcode.h"
 
 extern stackable staticMemory[];
 
 static const char* divisionByZeroMessage = "Division by zero";
 
+// The number of nested calls of execute(). Natives calling back into java code might hold
+// references in C variables, so the nursery is only scavenged at depth 1:
+static int executeDepth;
+
 static void inUndefinedInstruction(const char* file, int line) {
 	consout("%s:%d: Undefined instruction at 0x%04x\n", file, line, context.programCounter - 1);
 	jvmexit(1);
@@ -33,53 +38,138 @@ void execute() {
 	// Instantiate static jump table:
 	static JUMP_TABLE;
 
+	// The pre-decoded code; see threadedcode.h:
+	threadedInstruction* const tcode = tcGetThreadedCode(jumpTable);
+
+	// The interpreter registers. These are copies of the program counter, stack pointer and
+	// frame pointer from 'context'; see LOAD_CONTEXT and SAVE_CONTEXT:
+	register threadedInstruction* ip;
+	register stackable* sp;
+	register stackable* fp;
+	stackable* sb;
+	stackable* sl;
+	// Number of safepoint polls left before trying to yield:
+	register int yieldCountdown = YIELD_POLL_INTERVAL;
+
+	executeDepth++;
+	LOAD_CONTEXT();
+	goto checkReturn;
+
 	/////////////////////////////////////////////////////////
-	// This is the point to go to when a new instruction shall be executed:
+	// Safepoint: Backward branches, invokes and returns go here before the next instruction:
 	/////////////////////////////////////////////////////////
-	nextInstruction:
+	pollSafepoint:
+
+	if (--yieldCountdown <= 0) {
+		yieldCountdown = YIELD_POLL_INTERVAL;
+		if (heapIsCollectionPending() && executeDepth == 1) {
+			// The stacks are the only references held by the interpreter; the objects move:
+			SAVE_CONTEXT();
+			heapCollectPending();
+			LOAD_CONTEXT();
+		}
+		if (frIsSchedulingEnabled()) {
+			HEAP_VALIDATE;
+			// Another thread might take over; it will use (and change) the context:
+			SAVE_CONTEXT();
+			frYield();
+			LOAD_CONTEXT();
+			HEAP_VALIDATE;
+		}
+	}
 
-	HEAP_VALIDATE;
-	tryYield();
-	HEAP_VALIDATE;
+	/////////////////////////////////////////////////////////
+	// Instructions which might have popped a frame (returns, throws) go here:
+	/////////////////////////////////////////////////////////
+	checkReturn:
 
 	if (context.flags & RETURN_FROM_VM) {
 		// Clear return flag: this is a one-shot:
 		context.flags &= ~RETURN_FROM_VM;
+		SAVE_CONTEXT();
+		executeDepth--;
 		return;
 	}
 
-	context.exceptionThrown = FALSE;
-	// Note! 'code' is u1[] and we have 256 entries in the array => no check needed
-	goto *jumpTable[code[context.programCounter++]];
+	/////////////////////////////////////////////////////////
+	// This is the point to go to when a new instruction shall be executed:
+	/////////////////////////////////////////////////////////
+	nextInstruction:
+
+	goto *(ip++)->handler;
 
 	/////////////////////////////////////////////////////////
 	// Instructions BEGIN
 	/////////////////////////////////////////////////////////
 
 
-	IFINS(f_ifeq, operandStackPopJavaInt() == 0)
-	IFINS(f_ifne, operandStackPopJavaInt() != 0)
-	IFINS(f_ifgt, operandStackPopJavaInt() > 0)
-	IFINS(f_ifle, operandStackPopJavaInt() <= 0)
-	IFINS(f_iflt, operandStackPopJavaInt() < 0)
-	IFINS(f_ifge, operandStackPopJavaInt() >= 0)
-	IFINS(f_if_icmpeq, operandStackPopJavaInt() == operandStackPopJavaInt())
-	IFINS(f_if_icmpne, operandStackPopJavaInt() != operandStackPopJavaInt())
-	IFINS(f_if_acmpeq, operandStackPopObjectRef() == operandStackPopObjectRef())
-	IFINS(f_if_acmpne, operandStackPopObjectRef() != operandStackPopObjectRef())
-	// Note! Left is pushed first and popped last => the condition shall be 'inverted'
-	IFINS(f_if_icmple, operandStackPopJavaInt() >= operandStackPopJavaInt())
-	IFINS(f_if_icmplt, operandStackPopJavaInt() > operandStackPopJavaInt())
-	IFINS(f_if_icmpge, operandStackPopJavaInt() <= operandStackPopJavaInt())
-	IFINS(f_if_icmpgt, operandStackPopJavaInt() < operandStackPopJavaInt())
-
-	IFINS(f_ifnonnull, operandStackPopObjectRef() != NULL)
-	IFINS(f_ifnull, operandStackPopObjectRef() == NULL)
-
-	IFINS(f_goto, TRUE)
+	IFINS(f_ifeq, ==)
+	IFINS(f_ifne, !=)
+	IFINS(f_ifgt, >)
+	IFINS(f_ifle, <=)
+	IFINS(f_iflt, <)
+	IFINS(f_ifge, >=)
+	IFICMPINS(f_if_icmpeq, ==)
+	IFICMPINS(f_if_icmpne, !=)
+	IFACMPINS(f_if_acmpeq, ==)
+	IFACMPINS(f_if_acmpne, !=)
+	IFICMPINS(f_if_icmple, <=)
+	IFICMPINS(f_if_icmplt, <)
+	IFICMPINS(f_if_icmpge, >=)
+	IFICMPINS(f_if_icmpgt, >)
+
+	IFNULLINS(f_ifnonnull, !=)
+	IFNULLINS(f_ifnull, ==)
+
+	INS_BEGIN(f_goto) {
+		BRANCH();
+	}
+	INS_END
+
+	// The operands of the switches are decoded into the entries following the instruction; see
+	// threadedcode.h:
+	INS_BEGIN(f_tableswitch) {
+		jint index;
+		POP_INT(index);
+		jint low = ip[1].operand.value;
+		jint high = ip[2].operand.value;
+
+		if (index >= low && index <= high) {
+			BRANCH_TO(ip[3 + (index - low)].operand.target);
+		} else {
+			BRANCH_TO(ip[0].operand.target);
+		}
+	}
+	INS_END
+
+	INS_BEGIN(f_lookupswitch) {
+		jint key;
+		POP_INT(key);
+		const threadedInstruction* pairs = &ip[2];
+		threadedInstruction* target = ip[0].operand.target;
+
+		// Binary search; the matches are sorted:
+		int l = 0;
+		int r = ip[1].operand.value - 1;
+		while (l <= r) {
+			int center = (l + r) / 2;
+			jint match = pairs[2 * center].operand.value;
+			if (key < match) {
+				r = center - 1;
+			} else if (key > match) {
+				l = center + 1;
+			} else {
+				target = pairs[2 * center + 1].operand.target;
+				break;
+			}
+		}
+
+		BRANCH_TO(target);
+	}
+	INS_END
 	//
 	//
-	INS_BEGIN(f_athrow){
+	INS_CONTEXT_BEGIN(f_athrow){
 	// pop exception:
 	jobject exception = operandStackPopObjectRef();
 	if (exception == NULL) {
@@ -89,29 +179,29 @@ void execute() {
 	}
 }
 //
-INS_END
+INS_CONTEXT_END
 
 INS_BEGIN(f_monitorenter) {
+	SAVE_CONTEXT();
 	consout("f_monitorenter: not implemented\n");
 }
 INS_END
 
 INS_BEGIN(f_monitorexit) {
+	SAVE_CONTEXT();
 	consout("f_monitorexit: not implemented\n");
 }
 INS_END
 
 INS_BEGIN(f_pop) {
-	stackable op;
-	pop(&op);
+	DISCARD_STACKABLE();
 }
 INS_END
 
 INS_BEGIN(f_pop2) {
 	// When pop'ing we exploit that a category 2 consists of two entries on the stack:
-	stackable op;
-	pop(&op);
-	pop(&op);
+	DISCARD_STACKABLE();
+	DISCARD_STACKABLE();
 }
 INS_END
 
@@ -119,102 +209,82 @@ INS_BEGIN(f_nop)
 // No-op!
 INS_END
 
-INS_BEGIN(f_new) {
+INS_CONTEXT_BEGIN(f_new) {
 	u2 constantPoolIndex = getU2FromCode();
 	u2 classId;
 	getClassReference(constantPoolIndex, &classId);
 
+	// No references are held outside the stacks, so the allocation may compact the heap:
+	heapSetCompactionAllowed(executeDepth == 1);
 	jobject jref = newObject(classId);
+	heapSetCompactionAllowed(FALSE);
 
 	if (jref != NULL) {
 		operandStackPushObjectRef(jref);
 	}
 }
-INS_END
+INS_CONTEXT_END
 
 INS_BEGIN(f_checkcast) {
-	u2 constantPoolIndex = getU2FromCode();
 	u2 classId_T;
-	getClassReference(constantPoolIndex, &classId_T);
-
-	// Get a copy of the item at the top of the stack:
-	stackable ref;
-	pop(&ref);
-	push(ref.operand, ref.type);
-
-	VALIDATE_TYPE(ref.type , OBJECTREF)
-
-	if (ref.operand.jref != NULL) {
-		u2 classId_S = oaGetClassIdFromObject(ref.operand.jref);
-
-		if (!CP_IsInstanceOf(classId_S, classId_T)) {
-			throwClassCastException(classId_S, classId_T);
-		}
-	}
-	//else: null is OK
+	getClassReference(OPERAND.index, &classId_T);
+	QUICKEN_TYPE_CHECK(OP_THINJ_CHECKCAST_QUICK, classId_T);
 }
 INS_END
 
 INS_BEGIN(f_instanceof) {
-	u2 constantPoolIndex = getU2FromCode();
 	u2 classId_T;
-	getClassReference(constantPoolIndex, &classId_T);
-
-	// Pop off the item at the top of the stack:
-	stackable ref;
-	pop(&ref);
-
-	VALIDATE_TYPE(ref.type, OBJECTREF);
-
-	jint instanceOf;
-
-	if (ref.operand.jref != NULL) {
-		u2 classId_S = oaGetClassIdFromObject(ref.operand.jref);
-		instanceOf = CP_IsInstanceOf(classId_S, classId_T) ? 1 : 0;
-	} else {
-		instanceOf = 0;
-	}
-
-	operandStackPushJavaInt(instanceOf);
+	getClassReference(OPERAND.index, &classId_T);
+	QUICKEN_TYPE_CHECK(OP_THINJ_INSTANCEOF_QUICK, classId_T);
 }
 INS_END
 
 INS_BEGIN(f_ishl) {
-	jint jint2 = operandStackPopJavaInt() & 0x1f;
-	jint jint1 = operandStackPopJavaInt();
-	operandStackPushJavaInt(jint1 << jint2);
+	jint jint2;
+	jint jint1;
+	POP_INT(jint2);
+	POP_INT(jint1);
+	PUSH_INT(jint1 << (jint2 & 0x1f));
 }
 INS_END
 
 INS_BEGIN(f_ishr) {
-	jint jint2 = operandStackPopJavaInt() & 0x1f;
-	jint jint1 = operandStackPopJavaInt();
-	operandStackPushJavaInt(jint1 >> jint2);
+	jint jint2;
+	jint jint1;
+	POP_INT(jint2);
+	POP_INT(jint1);
+	PUSH_INT(jint1 >> (jint2 & 0x1f));
 }
 INS_END
 
 INS_BEGIN(f_lshl) {
-	jint v2 = operandStackPopJavaInt() & 0x3f;
-	jlong v1 = operandStackPopJavaLong();
-	operandStackPushJavaLong(v1 << v2);
+	jint v2;
+	jlong v1;
+	POP_INT(v2);
+	POP_LONG(v1);
+	PUSH_LONG(v1 << (v2 & 0x3f));
 }
 INS_END
 
 INS_BEGIN(f_lshr) {
-	jint v2 = operandStackPopJavaInt() & 0x3f;
-	jlong v1 = operandStackPopJavaLong();
-	operandStackPushJavaLong(v1 >> v2);
+	jint v2;
+	jlong v1;
+	POP_INT(v2);
+	POP_LONG(v1);
+	PUSH_LONG(v1 >> (v2 & 0x3f));
 }
 INS_END
 
 INS_BEGIN(f_lushr) {
-	jint v2 = operandStackPopJavaInt() & 0x3f;
-	jlong v1 = operandStackPopJavaLong();
-	operandStackPushJavaLong(((ujlong)v1) >> v2);
+	jint v2;
+	jlong v1;
+	POP_INT(v2);
+	POP_LONG(v1);
+	PUSH_LONG(((ujlong)v1) >> (v2 & 0x3f));
 }
 INS_END
 
-INS_BEGIN(f_newarray) {
+INS_CONTEXT_BEGIN(f_newarray) {
 	ARRAY_TYPE type = (ARRAY_TYPE) getU1FromCode();
 	jint count = operandStackPopJavaInt();
 
@@ -223,6 +293,7 @@ INS_BEGIN(f_newarray) {
 	if (count < 0) {
 		throwNegativeArraySizeException();
 	} else {
+		heapSetCompactionAllowed(executeDepth == 1);
 		switch (type) {
 			case T_CHAR:
 			jobj = NewCharArray(count);
@@ -246,32 +317,25 @@ INS_BEGIN(f_newarray) {
 			consout("not impl: %d\n", type);
 			jvmexit(1);
 		}
+		heapSetCompactionAllowed(FALSE);
 		if (jobj != NULL) {
 			operandStackPushObjectRef(jobj);
 		}
 		// else: Out of mem has been thrown
 	}
 }
-INS_END
+INS_CONTEXT_END
 
 INS_BEGIN(f_anewarray) {
-	u2 constantPoolIndex = getU2FromCode();
 	u2 elementClassId;
-	getClassReference(constantPoolIndex, &elementClassId);
-	jint count = operandStackPopJavaInt();
-	if (count < 0) {
-		throwNegativeArraySizeException();
-	} else {
-		jobject jref = NewObjectArray(count, elementClassId, NULL);
-		if (jref != NULL) {
-			operandStackPushObjectRef(jref);
-		}
-		// else: Out of mem has been thrown
-	}
+	getClassReference(OPERAND.index, &elementClassId);
+	OPERAND.classId = getArrayClassIdForElementClassId(elementClassId);
+	QUICKEN(OP_THINJ_ANEWARRAY_QUICK);
+	ip--;
 }
 INS_END
 
-INS_BEGIN(f_aaload) {
+INS_CONTEXT_BEGIN(f_aaload) {
 	jint index = operandStackPopJavaInt();
 	jarray a = (jarray) operandStackPopObjectRef();
 	jobject value = GetObjectArrayElement(a, index);
@@ -280,18 +344,18 @@ INS_BEGIN(f_aaload) {
 		operandStackPushObjectRef(value);
 	}
 }
-INS_END
+INS_CONTEXT_END
 
-INS_BEGIN(f_aastore) {
+INS_CONTEXT_BEGIN(f_aastore) {
 	jobject value = operandStackPopObjectRef();
 	jint index = operandStackPopJavaInt();
 	jarray a = (jarray) operandStackPopObjectRef();
 
 	SetObjectArrayElement(a, index, value);
 }
-INS_END
+INS_CONTEXT_END
 
-INS_BEGIN(f_baload) {
+INS_CONTEXT_BEGIN(f_baload) {
 	jint index = operandStackPopJavaInt();
 	jarray a = (jarray) operandStackPopObjectRef();
 
@@ -317,9 +381,9 @@ INS_BEGIN(f_baload) {
 		}
 	}
 }
-INS_END
+INS_CONTEXT_END
 
-INS_BEGIN(f_bastore) {
+INS_CONTEXT_BEGIN(f_bastore) {
 	jint value = operandStackPopJavaInt();
 	jint index = operandStackPopJavaInt();
 	jarray a = (jarray) operandStackPopObjectRef();
@@ -340,9 +404,9 @@ INS_BEGIN(f_bastore) {
 		}
 	}
 }
-INS_END
+INS_CONTEXT_END
 
-INS_BEGIN(f_caload) {
+INS_CONTEXT_BEGIN(f_caload) {
 	jint index = operandStackPopJavaInt();
 	jarray a = (jarray) operandStackPopObjectRef();
 	jchar value = GetCharArrayElement(a, index);
@@ -351,9 +415,9 @@ INS_BEGIN(f_caload) {
 		operandStackPushJavaInt(value);
 	}
 }
-INS_END
+INS_CONTEXT_END
 
-INS_BEGIN(f_iaload) {
+INS_CONTEXT_BEGIN(f_iaload) {
 	jint index = operandStackPopJavaInt();
 	jarray a = (jarray) operandStackPopObjectRef();
 	jint value = GetIntArrayElement(a, index);
@@ -362,9 +426,9 @@ INS_BEGIN(f_iaload) {
 		operandStackPushJavaInt(value);
 	}
 }
-INS_END
+INS_CONTEXT_END
 
-INS_BEGIN(f_laload) {
+INS_CONTEXT_BEGIN(f_laload) {
 	jint index = operandStackPopJavaInt();
 	jarray a = (jarray) operandStackPopObjectRef();
 	jlong value = GetLongArrayElement(a, index);
@@ -373,36 +437,36 @@ INS_BEGIN(f_laload) {
 		operandStackPushJavaLong(value);
 	}
 }
-INS_END
+INS_CONTEXT_END
 
-INS_BEGIN(f_iastore) {
+INS_CONTEXT_BEGIN(f_iastore) {
 	jint value = operandStackPopJavaInt();
 	jint index = operandStackPopJavaInt();
 	jarray a = (jarray) operandStackPopObjectRef();
 
 	SetIntArrayElement(a, index, value);
 }
-INS_END
+INS_CONTEXT_END
 
-INS_BEGIN(f_lastore) {
+INS_CONTEXT_BEGIN(f_lastore) {
 	jlong value = operandStackPopJavaLong();
 	jint index = operandStackPopJavaInt();
 	jarray a = (jarray) operandStackPopObjectRef();
 
 	SetLongArrayElement(a, index, value);
 }
-INS_END
+INS_CONTEXT_END
 
-INS_BEGIN(f_castore) {
+INS_CONTEXT_BEGIN(f_castore) {
 	jint value = operandStackPopJavaInt();
 	jint index = operandStackPopJavaInt();
 	jarray a = (jarray) operandStackPopObjectRef();
 
 	SetCharArrayElement(a, index, value);
 }
-INS_END
+INS_CONTEXT_END
 
-INS_BEGIN(f_arraylength) {
+INS_CONTEXT_BEGIN(f_arraylength) {
 	array_t * a = (array_t*) operandStackPopObjectRef();
 	if (a == NULL) {
 		throwNullPointerException();
@@ -410,24 +474,27 @@ INS_BEGIN(f_arraylength) {
 		operandStackPushJavaInt(GetArrayLength(a));
 	}
 }
-INS_END
+INS_CONTEXT_END
 
 INS_BEGIN(f_iinc) {
-	u1 varnum = getU1FromCode();
-	jint delta = (jint) getS1FromCode();
-	operandStackIncrementVariableJavaInt(varnum, delta);
+	u1 varnum = OPERAND.iinc.index;
+	jint delta = (jint) OPERAND.iinc.delta;
+	SKIP_OPERANDS(2);
+	stackable* local = &LOCAL(varnum);
+	VALIDATE_REGISTER_TYPE(local->type, JAVAINT);
+	local->operand.jrenameint += delta;
 }
 INS_END
 
 INS_BEGIN(f_dup_x1) {
 	stackable value1;
-	pop(&value1);
+	POP_STACKABLE(value1);
 	stackable value2;
-	pop(&value2);
+	POP_STACKABLE(value2);
 
-	push(value1.operand, value1.type);
-	push(value2.operand, value2.type);
-	push(value1.operand, value1.type);
+	PUSH_STACKABLE(value1);
+	PUSH_STACKABLE(value2);
+	PUSH_STACKABLE(value1);
 }
 INS_END
 
@@ -435,137 +502,145 @@ INS_BEGIN(f_dup2_x1) {
 	// When dup'ing we exploit that a category 2 consists of two entries on the stack:
 	//..., value3, value2, value1 => ..., value2, value1, value3, value2, value1
 	stackable value1;
-	pop(&value1);
+	POP_STACKABLE(value1);
 	stackable value2;
-	pop(&value2);
+	POP_STACKABLE(value2);
 	stackable value3;
-	pop(&value3);
+	POP_STACKABLE(value3);
 
-	push(value2.operand, value2.type);
-	push(value1.operand, value1.type);
+	PUSH_STACKABLE(value2);
+	PUSH_STACKABLE(value1);
 
-	push(value3.operand, value3.type);
+	PUSH_STACKABLE(value3);
 
-	push(value2.operand, value2.type);
-	push(value1.operand, value1.type);
+	PUSH_STACKABLE(value2);
+	PUSH_STACKABLE(value1);
 }
 INS_END
 
 INS_BEGIN(f_dup) {
 	stackable st;
-	pop(&st);
-	push(st.operand, st.type);
-	push(st.operand, st.type);
+	POP_STACKABLE(st);
+	PUSH_STACKABLE(st);
+	PUSH_STACKABLE(st);
 }
 INS_END
 
 INS_BEGIN(f_dup2) {
 	stackable st2;
-	pop(&st2);
+	POP_STACKABLE(st2);
 	stackable st1;
-	pop(&st1);
+	POP_STACKABLE(st1);
 
-	push(st1.operand, st1.type);
-	push(st2.operand, st2.type);
-	push(st1.operand, st1.type);
-	push(st2.operand, st2.type);
+	PUSH_STACKABLE(st1);
+	PUSH_STACKABLE(st2);
+	PUSH_STACKABLE(st1);
+	PUSH_STACKABLE(st2);
 }
 INS_END
 
 INS_BEGIN(f_bipush) {
-	// Sign extend:
-	s1 val = getU1FromCode();
-	operandStackPushJavaInt((jint) val);
+	// Sign extended during translation:
+	jint val = OPERAND.value;
+	SKIP_OPERANDS(1);
+	PUSH_INT(val);
 }
 INS_END
 
 INS_BEGIN(f_sipush) {
-	s2 val = getS2FromCode();
-	operandStackPushJavaInt((jint) val);
+	jint val = OPERAND.value;
+	SKIP_OPERANDS(2);
+	PUSH_INT(val);
 }
 INS_END
 
 INS_BEGIN(f_i2b) {
-	jint val = operandStackPopJavaInt();
+	jint val;
+	POP_INT(val);
 	val = val & 0xff;
 	if ((val & 0xffffff80) != 0) {
 		// Sign extend:
 		val |= 0xffffff00;
 	}
-	operandStackPushJavaInt(val);
+	PUSH_INT(val);
 }
 INS_END
 
 INS_BEGIN(f_i2c) {
-	jint val = operandStackPopJavaInt();
+	jint val;
+	POP_INT(val);
 	val = val & 0xff;
-	operandStackPushJavaInt(val);
+	PUSH_INT(val);
 }
 INS_END
 
 INS_BEGIN(f_l2i) {
-	jlong val = operandStackPopJavaLong();
-	operandStackPushJavaInt((jint)val);
+	jlong val;
+	POP_LONG(val);
+	PUSH_INT((jint)val);
 }
 INS_END
 
 INS_BEGIN(f_i2l) {
-	jint v1 = operandStackPopJavaInt();
-	operandStackPushJavaLong((jlong)v1);
+	jint v1;
+	POP_INT(v1);
+	PUSH_LONG((jlong)v1);
 }
 INS_END
 
-INS_BEGIN(f_ldc) {
+INS_CONTEXT_BEGIN(f_ldc) {
 	cpCommonLDC(getU1FromCode());
 }
-INS_END
+INS_CONTEXT_END
 
-INS_BEGIN(f_ldc_w) {
+INS_CONTEXT_BEGIN(f_ldc_w) {
 	cpCommonLDC(getU2FromCode());
 }
-INS_END
+INS_CONTEXT_END
 
-INS_BEGIN(f_ldc2_w) {
+INS_CONTEXT_BEGIN(f_ldc2_w) {
 	cpCommonLDC(getU2FromCode());
 }
-INS_END
+INS_CONTEXT_END
 
-INS_BEGIN(f_vreturn) {
+INS_CONTEXT_BEGIN(f_vreturn) {
 	pop_frame();
 }
-INS_END
+INS_CALL_END
 
-INS_BEGIN(f_invokeinterface) {
-	u2 methodRef = getU2FromCode();
-	getU1FromCode(); // 'count'
-	getU1FromCode(); // shall always be 0 - but who cares ?!
+INS_CONTEXT_BEGIN(f_invokeinterface) {
+	// Skip the constant pool index, 'count' and 0:
+	context.programCounter += 4;
 
-	const methodInClass * mic = getVirtualMethodEntry(methodRef);
+	const methodInClass * mic = icGetVirtualMethodEntry(OPERAND.cache);
 
 	if (mic != NULL) {
 		invokeCommon(mic, FALSE);
 	}
 }
-INS_END
+INS_CALL_END
 
-INS_BEGIN(f_invokevirtual) {
-	u2 methodRef = getU2FromCode();
+INS_CONTEXT_BEGIN(f_invokevirtual) {
+	// Skip the constant pool index:
+	context.programCounter += 2;
 
 	//---------------------------------------------------------------
 	const methodInClass * mic;
-	mic = getVirtualMethodEntry(methodRef);
+	mic = icGetVirtualMethodEntry(OPERAND.cache);
 
 	if (mic != NULL) {
 		invokeCommon(mic, FALSE);
 	}
 	//---------------------------------------------------------------
 }
-INS_END
+INS_CALL_END
 
-INS_BEGIN(f_invokespecial) {
+INS_CONTEXT_BEGIN(f_invokespecial) {
 	u2 methodRef = getU2FromCode();
 
 	const methodInClass * mic = getStaticMethodEntry(context.classIndex, methodRef);
+	QUICKEN_INTRINSIC(mic);
+	QUICKEN_METHOD(OP_THINJ_INVOKESPECIAL_QUICK, mic);
 
 	if (osIsObjectRefAtOffsetNull(mic->numberOfArguments)) {
 		throwNullPointerException();
@@ -573,110 +648,52 @@ INS_BEGIN(f_invokespecial) {
 		invokeCommon(mic, FALSE);
 	}
 }
-INS_END
+INS_CALL_END
 
-INS_BEGIN(f_invokestatic) {
+INS_CONTEXT_BEGIN(f_invokestatic) {
 	u2 staticMethodRef = getU2FromCode();
 
 	const methodInClass* mic = getStaticMethodEntry(context.classIndex, staticMethodRef);
+	QUICKEN_METHOD(OP_THINJ_INVOKESTATIC_QUICK, mic);
 
 	invokeCommon(mic, FALSE);
 }
-INS_END
+INS_CALL_END
 
 INS_BEGIN(f_getstatic) {
-	u2 staticFieldRef = getU2FromCode();
 	u2 address;
 	u1 size;
-
-	getStaticFieldEntry(staticFieldRef, &address, &size);
-
-	// MSValue at highest addres; LSValue at lowest:
-	stackable value = staticMemory[address];
-	push(value.operand, value.type);
-
-	if (size == 2) {
-		stackable value = staticMemory[address+1];
-		push(value.operand, value.type);
-	}
+	getStaticFieldEntry(OPERAND.index, &address, &size);
+	QUICKEN_FIELD(OP_THINJ_GETSTATIC_QUICK, address, size);
 }
 INS_END
 
 INS_BEGIN(f_putstatic) {
-	u2 staticFieldRef = getU2FromCode();
 	u2 address;
 	u1 size;
-	getStaticFieldEntry(staticFieldRef, &address, &size);
-	stackable value;
-
-	// MSValue at highest addres; LSValue at lowest:
-	if (size == 2) {
-		pop(&value);
-		staticMemory[address+1] = value;
-	}
-
-	pop(&value);
-	staticMemory[address] = value;
+	getStaticFieldEntry(OPERAND.index, &address, &size);
+	QUICKEN_FIELD(OP_THINJ_PUTSTATIC_QUICK, address, size);
 }
 INS_END
 
 INS_BEGIN(f_putfield) {
-	u2 fieldRef = getU2FromCode();
 	u2 address;
 	u1 size;
 	// putfield is relative to 'this', which is pushed onto the stack prior to this instruction
-	getInstanceFieldEntry(fieldRef, &address, &size);
-
-	stackable msValue;
-	pop(&msValue);
-	stackable lsValue;
-	if (size == 2) {
-		pop(&lsValue);
-	}
-	stackable this;
-	pop(&this);
-	VALIDATE_TYPE(this.type, OBJECTREF);
-
-	if (size == 1) {
-		PutField(this.operand.jref, address, &msValue);
-	} else if (size == 2) {
-		PutField(this.operand.jref, address, &lsValue);
-		PutField(this.operand.jref, address+1, &msValue);
-	} else {
-		consout("No support for size != 1 or 2: %d\n", size);
-		jvmexit(1);
-	}
+	getInstanceFieldEntry(OPERAND.index, &address, &size);
+	QUICKEN_FIELD(OP_THINJ_PUTFIELD_QUICK, address, size);
 }
 INS_END
 
 INS_BEGIN(f_getfield) {
-	u2 fieldRef = getU2FromCode();
 	u2 address;
 	u1 size;
-	//consoutli("getfield: %04x\n", context.programCounter);
-	getInstanceFieldEntry(fieldRef, &address, &size);
-	stackable this;
-	pop(&this);
-	if (this.operand.jref != NULL) {
-		if (size == 1) {
-			stackable * value = GetField(this.operand.jref, address);
-			push(value->operand, value->type);
-		} else if (size == 2) {
-			stackable * value = GetField(this.operand.jref, address);
-			push(value->operand, value->type);
-			value = GetField(this.operand.jref, address + 1);
-			push(value->operand, value->type);
-		} else {
-			consout("No support for size != 1 or 2: %d\n", size);
-			jvmexit(1);
-		}
-	} else {
-		throwNullPointerException();
-	}
+	getInstanceFieldEntry(OPERAND.index, &address, &size);
+	QUICKEN_FIELD(OP_THINJ_GETFIELD_QUICK, address, size);
 }
 INS_END
 
-INS_BEGIN(f_areturn) {
+INS_CONTEXT_BEGIN(f_areturn) {
 	// Object return value:
 	jobject jref = operandStackPopObjectRef();
 
@@ -685,9 +702,9 @@ INS_BEGIN(f_areturn) {
 	// Push result:
 	operandStackPushObjectRef(jref);
 }
-INS_END
+INS_CALL_END
 
-INS_BEGIN(f_ireturn) {
+INS_CONTEXT_BEGIN(f_ireturn) {
 	// Integer return value:
 	jint jrenameint = operandStackPopJavaInt();
 
@@ -696,9 +713,9 @@ INS_BEGIN(f_ireturn) {
 	// Push result:
 	operandStackPushJavaInt(jrenameint);
 }
-INS_END
+INS_CALL_END
 
-INS_BEGIN(f_lreturn) {
+INS_CONTEXT_BEGIN(f_lreturn) {
 	// Long return value:
 	jlong j = operandStackPopJavaLong();
 
@@ -707,334 +724,388 @@ INS_BEGIN(f_lreturn) {
 	// Push result:
 	operandStackPushJavaLong(j);
 }
-INS_END
+INS_CALL_END
 
 INS_BEGIN(f_aload) {
-	u1 index = getU1FromCode();
-	operandStackPushVariableObjectRef(index);
+	u1 index = OPERAND.index;
+	SKIP_OPERANDS(1);
+	PUSH_LOCAL(index, OBJECTREF);
 }
 INS_END
 
 INS_BEGIN(f_aload_0) {
-	operandStackPushVariableObjectRef(0);
+	PUSH_LOCAL(0, OBJECTREF);
 }
 INS_END
 
 INS_BEGIN(f_aload_1) //
-operandStackPushVariableObjectRef(1);
+PUSH_LOCAL(1, OBJECTREF);
 INS_END
 
 INS_BEGIN(f_aload_2) //
-operandStackPushVariableObjectRef(2);
+PUSH_LOCAL(2, OBJECTREF);
 INS_END
 
 INS_BEGIN(f_aload_3) //
-operandStackPushVariableObjectRef(3);
+PUSH_LOCAL(3, OBJECTREF);
 INS_END
 
 INS_BEGIN(f_iload) //
-u1 index = getU1FromCode();
-operandStackPushVariableJavaInt(index);
+u1 index = OPERAND.index;
+SKIP_OPERANDS(1);
+PUSH_LOCAL(index, JAVAINT);
 INS_END
 
 INS_BEGIN(f_iload_0) //
-operandStackPushVariableJavaInt(0);
+PUSH_LOCAL(0, JAVAINT);
 INS_END
 
 INS_BEGIN(f_iload_1) //
-operandStackPushVariableJavaInt(1);
+PUSH_LOCAL(1, JAVAINT);
 INS_END
 
 INS_BEGIN(f_iload_2) //
-operandStackPushVariableJavaInt(2);
+PUSH_LOCAL(2, JAVAINT);
 INS_END
 
 INS_BEGIN(f_iload_3) //
-operandStackPushVariableJavaInt(3);
+PUSH_LOCAL(3, JAVAINT);
 INS_END
 
 INS_BEGIN(f_lload) {
-	u1 index = getU1FromCode();
-	operandStackPushVariableJavaLong(index);
+	u1 index = OPERAND.index;
+	SKIP_OPERANDS(1);
+	PUSH_LOCAL(index, JAVAINT);
+	PUSH_LOCAL(index + 1, JAVAINT);
 }
 INS_END
 
 INS_BEGIN(f_lload_0) {
-	operandStackPushVariableJavaLong(0);
+	PUSH_LOCAL(0, JAVAINT);
+	PUSH_LOCAL(1, JAVAINT);
 }
 INS_END
 
 INS_BEGIN(f_lload_1) {
-	operandStackPushVariableJavaLong(1);
+	PUSH_LOCAL(1, JAVAINT);
+	PUSH_LOCAL(2, JAVAINT);
 }
 INS_END
 
 INS_BEGIN(f_lload_2) {
-	operandStackPushVariableJavaLong(2);
+	PUSH_LOCAL(2, JAVAINT);
+	PUSH_LOCAL(3, JAVAINT);
 }
 INS_END
 
 INS_BEGIN(f_lload_3) {
-	operandStackPushVariableJavaLong(3);
+	PUSH_LOCAL(3, JAVAINT);
+	PUSH_LOCAL(4, JAVAINT);
 }
 INS_END
 
 INS_BEGIN(f_aconst_null) //
-operandStackPushObjectRef((jobject) NULL);
+PUSH_REF((jobject) NULL);
 INS_END
 
 INS_BEGIN(f_iconst_m1) //
-operandStackPushJavaInt(-1);
+PUSH_INT(-1);
 INS_END
 
 INS_BEGIN(f_iconst_0) //
-operandStackPushJavaInt(0);
+PUSH_INT(0);
 INS_END
 
 INS_BEGIN(f_iconst_1) //
-operandStackPushJavaInt(1);
+PUSH_INT(1);
 INS_END
 
 INS_BEGIN(f_iconst_2) //
-operandStackPushJavaInt(2);
+PUSH_INT(2);
 INS_END
 
 INS_BEGIN(f_iconst_3) //
-operandStackPushJavaInt(3);
+PUSH_INT(3);
 INS_END
 
 INS_BEGIN(f_iconst_4) //
-operandStackPushJavaInt(4);
+PUSH_INT(4);
 INS_END
 
 INS_BEGIN(f_iconst_5) //
-operandStackPushJavaInt(5);
+PUSH_INT(5);
 INS_END
 
 INS_BEGIN(f_lconst_0) {
-	operandStackPushJavaLong(0);
+	PUSH_LONG(0);
 }
 INS_END
 
 INS_BEGIN(f_lconst_1) {
-	operandStackPushJavaLong(1);
+	PUSH_LONG(1);
 }
 INS_END
 
 INS_BEGIN(f_isub) {
-	jint jrenameint1 = operandStackPopJavaInt();
-	jint jrenameint2 = operandStackPopJavaInt();
-	operandStackPushJavaInt(jrenameint2 - jrenameint1);
+	jint jrenameint1;
+	jint jrenameint2;
+	POP_INT(jrenameint1);
+	POP_INT(jrenameint2);
+	PUSH_INT(jrenameint2 - jrenameint1);
 }
 INS_END
 
 INS_BEGIN(f_lsub) {
-	jlong j1 = operandStackPopJavaLong();
-	jlong j2 = operandStackPopJavaLong();
-	operandStackPushJavaLong(j2 - j1);
+	jlong j1;
+	jlong j2;
+	POP_LONG(j1);
+	POP_LONG(j2);
+	PUSH_LONG(j2 - j1);
 }
 INS_END
 
 INS_BEGIN(f_iand) {
-	jint jrenameint1 = operandStackPopJavaInt();
-	jint jrenameint2 = operandStackPopJavaInt();
-	operandStackPushJavaInt(jrenameint2 & jrenameint1);
+	jint jrenameint1;
+	jint jrenameint2;
+	POP_INT(jrenameint1);
+	POP_INT(jrenameint2);
+	PUSH_INT(jrenameint2 & jrenameint1);
 }
 INS_END
 
 INS_BEGIN(f_ior) //
-jint jrenameint1 = operandStackPopJavaInt();
-jint jrenameint2 = operandStackPopJavaInt();
-operandStackPushJavaInt(jrenameint2 | jrenameint1);
+jint jrenameint1;
+jint jrenameint2;
+POP_INT(jrenameint1);
+POP_INT(jrenameint2);
+PUSH_INT(jrenameint2 | jrenameint1);
 INS_END
 
 INS_BEGIN(f_ixor)
-jint jrenameint1 = operandStackPopJavaInt();
-jint jrenameint2 = operandStackPopJavaInt();
-operandStackPushJavaInt(jrenameint2 ^ jrenameint1);
+jint jrenameint1;
+jint jrenameint2;
+POP_INT(jrenameint1);
+POP_INT(jrenameint2);
+PUSH_INT(jrenameint2 ^ jrenameint1);
 INS_END
 
 INS_BEGIN(f_land) {
-	jlong j1 = operandStackPopJavaLong();
-	jlong j2 = operandStackPopJavaLong();
-	operandStackPushJavaLong(j2 & j1);
+	jlong j1;
+	jlong j2;
+	POP_LONG(j1);
+	POP_LONG(j2);
+	PUSH_LONG(j2 & j1);
 }
 INS_END
 
 INS_BEGIN(f_lor) {
-	jlong j1 = operandStackPopJavaLong();
-	jlong j2 = operandStackPopJavaLong();
-	operandStackPushJavaLong(j2 | j1);
+	jlong j1;
+	jlong j2;
+	POP_LONG(j1);
+	POP_LONG(j2);
+	PUSH_LONG(j2 | j1);
 }
 INS_END
 
 INS_BEGIN(f_lxor) {
-	jlong j1 = operandStackPopJavaLong();
-	jlong j2 = operandStackPopJavaLong();
-	operandStackPushJavaLong(j2 ^ j1);
+	jlong j1;
+	jlong j2;
+	POP_LONG(j1);
+	POP_LONG(j2);
+	PUSH_LONG(j2 ^ j1);
 }
 INS_END
 
 INS_BEGIN(f_iadd) {
-	jint jrenameint1 = operandStackPopJavaInt();
-	jint jrenameint2 = operandStackPopJavaInt();
-	operandStackPushJavaInt(jrenameint2 + jrenameint1);
+	jint jrenameint1;
+	jint jrenameint2;
+	POP_INT(jrenameint1);
+	POP_INT(jrenameint2);
+	PUSH_INT(jrenameint2 + jrenameint1);
 }
 INS_END
 
 INS_BEGIN(f_ladd) {
-	jlong j1 = operandStackPopJavaLong();
-	jlong j2 = operandStackPopJavaLong();
-	operandStackPushJavaLong(j2 + j1);
+	jlong j1;
+	jlong j2;
+	POP_LONG(j1);
+	POP_LONG(j2);
+	PUSH_LONG(j2 + j1);
 }
 INS_END
 
 INS_BEGIN(f_idiv) {
-	jint jrenameint1 = operandStackPopJavaInt();
-	jint jrenameint2 = operandStackPopJavaInt();
+	jint jrenameint1;
+	jint jrenameint2;
+	POP_INT(jrenameint1);
+	POP_INT(jrenameint2);
 	if (jrenameint1 == 0) {
-		throwArithmeticException(divisionByZeroMessage);
+		INS_THROW(throwArithmeticException(divisionByZeroMessage));
 	} else {
-		operandStackPushJavaInt(jrenameint2 / jrenameint1);
+		PUSH_INT(jrenameint2 / jrenameint1);
 	}
 }
 INS_END
 
 INS_BEGIN(f_ldiv) {
-	jlong j1 = operandStackPopJavaLong();
-	jlong j2 = operandStackPopJavaLong();
+	jlong j1;
+	jlong j2;
+	POP_LONG(j1);
+	POP_LONG(j2);
 	if (j1 == 0) {
-		throwArithmeticException(divisionByZeroMessage);
+		INS_THROW(throwArithmeticException(divisionByZeroMessage));
 	} else {
-		operandStackPushJavaLong(j2 / j1);
+		PUSH_LONG(j2 / j1);
 	}
 }
 INS_END
 
 INS_BEGIN(f_ineg) {
-	operandStackPushJavaInt(-operandStackPopJavaInt());
+	jint v;
+	POP_INT(v);
+	PUSH_INT(-v);
 }
 INS_END
 
 INS_BEGIN(f_lneg) {
-	operandStackPushJavaLong(-operandStackPopJavaLong());
+	jlong j;
+	POP_LONG(j);
+	PUSH_LONG(-j);
 }
 INS_END
 
 INS_BEGIN(f_irem) {
-	jint v1 = operandStackPopJavaInt();
-	jint v2 = operandStackPopJavaInt();
+	jint v1;
+	jint v2;
+	POP_INT(v1);
+	POP_INT(v2);
 	if (v1 == 0) {
-		throwArithmeticException(divisionByZeroMessage);
+		INS_THROW(throwArithmeticException(divisionByZeroMessage));
 	} else {
-		operandStackPushJavaInt(v2 % v1);
+		PUSH_INT(v2 % v1);
 	}
 }
 INS_END
 
 INS_BEGIN(f_lrem) {
-	jlong j1 = operandStackPopJavaLong();
-	jlong j2 = operandStackPopJavaLong();
+	jlong j1;
+	jlong j2;
+	POP_LONG(j1);
+	POP_LONG(j2);
 	if (j1 == 0) {
-		throwArithmeticException(divisionByZeroMessage);
+		INS_THROW(throwArithmeticException(divisionByZeroMessage));
 	} else {
-		operandStackPushJavaLong(j2 % j1);
+		PUSH_LONG(j2 % j1);
 	}
 }
 INS_END
 
 INS_BEGIN(f_imul) {
-	jint jrenameint1 = operandStackPopJavaInt();
-	jint jrenameint2 = operandStackPopJavaInt();
-	operandStackPushJavaInt(jrenameint2 * jrenameint1);
+	jint jrenameint1;
+	jint jrenameint2;
+	POP_INT(jrenameint1);
+	POP_INT(jrenameint2);
+	PUSH_INT(jrenameint2 * jrenameint1);
 }
 INS_END
 
 INS_BEGIN(f_lmul) {
-	jlong j1 = operandStackPopJavaLong();
-	jlong j2 = operandStackPopJavaLong();
-	operandStackPushJavaLong(j2 * j1);
+	jlong j1;
+	jlong j2;
+	POP_LONG(j1);
+	POP_LONG(j2);
+	PUSH_LONG(j2 * j1);
 }
 INS_END
 
 INS_BEGIN(f_astore) //
-u1 index = getU1FromCode();
-operandStackPopVariableObjectRef(index);
+u1 index = OPERAND.index;
+SKIP_OPERANDS(1);
+POP_LOCAL(index, OBJECTREF);
 INS_END
 
 INS_BEGIN(f_astore_0) //
-operandStackPopVariableObjectRef(0);
+POP_LOCAL(0, OBJECTREF);
 INS_END
 
 INS_BEGIN(f_astore_1) //
-operandStackPopVariableObjectRef(1);
+POP_LOCAL(1, OBJECTREF);
 INS_END
 
 INS_BEGIN(f_astore_2) //
-operandStackPopVariableObjectRef(2);
+POP_LOCAL(2, OBJECTREF);
 INS_END
 
 INS_BEGIN(f_astore_3) //
-operandStackPopVariableObjectRef(3);
+POP_LOCAL(3, OBJECTREF);
 INS_END
 
 INS_BEGIN(f_istore) //
-u1 index = getU1FromCode();
-operandStackPopVariableJavaInt(index);
+u1 index = OPERAND.index;
+SKIP_OPERANDS(1);
+POP_LOCAL(index, JAVAINT);
 INS_END
 
 INS_BEGIN(f_istore_0) //
-operandStackPopVariableJavaInt(0);
+POP_LOCAL(0, JAVAINT);
 INS_END
 
 INS_BEGIN(f_istore_1) //
-operandStackPopVariableJavaInt(1);
+POP_LOCAL(1, JAVAINT);
 INS_END
 
 INS_BEGIN(f_istore_2) //
-operandStackPopVariableJavaInt(2);
+POP_LOCAL(2, JAVAINT);
 INS_END
 
 INS_BEGIN(f_istore_3) //
-operandStackPopVariableJavaInt(3);
+POP_LOCAL(3, JAVAINT);
 INS_END
 
 INS_BEGIN(f_lstore) {
-	u1 index = getU1FromCode();
-	operandStackPopVariableJavaLong(index);
+	u1 index = OPERAND.index;
+	SKIP_OPERANDS(1);
+	POP_LOCAL(index + 1, JAVAINT);
+	POP_LOCAL(index, JAVAINT);
 }
 INS_END
 
 INS_BEGIN(f_lstore_0) {
-	operandStackPopVariableJavaLong(0);
+	POP_LOCAL(1, JAVAINT);
+	POP_LOCAL(0, JAVAINT);
 }
 INS_END
 
 INS_BEGIN(f_lstore_1) {
-	operandStackPopVariableJavaLong(1);
+	POP_LOCAL(2, JAVAINT);
+	POP_LOCAL(1, JAVAINT);
 }
 INS_END
 
 INS_BEGIN(f_lstore_2) {
-	operandStackPopVariableJavaLong(2);
+	POP_LOCAL(3, JAVAINT);
+	POP_LOCAL(2, JAVAINT);
 }
 INS_END
 
 INS_BEGIN(f_lstore_3) {
-	operandStackPopVariableJavaLong(3);
+	POP_LOCAL(4, JAVAINT);
+	POP_LOCAL(3, JAVAINT);
 }
 INS_END
 
 INS_BEGIN(f_lcmp) {
-	jlong val1 = operandStackPopJavaLong();
-	jlong val2 = operandStackPopJavaLong();
+	jlong val1;
+	jlong val2;
+	POP_LONG(val1);
+	POP_LONG(val2);
 	if (val2 > val1) {
-		operandStackPushJavaInt(1);
+		PUSH_INT(1);
 	} else
 	if (val2 < val1) {
-		operandStackPushJavaInt(-1);
+		PUSH_INT(-1);
 	} else {
-		operandStackPushJavaInt(0);
+		PUSH_INT(0);
 	}
 }
 INS_END
@@ -1043,6 +1114,249 @@ INS_END
 // Instructions END
 /////////////////////////////////////////////////////////
 
+/////////////////////////////////////////////////////
+// Superinstructions BEGIN
+// These are installed by the translation into threaded code (see threadedcode.c) at the first
+// instruction of a common sequence. The entries of the remaining instructions in the sequence are
+// untouched, so branching into the middle of a sequence is OK.
+/////////////////////////////////////////////////////
+
+INS_BEGIN(f_thinj_aload_0_getfield) {
+	if (ip->handler == jumpTable[OP_THINJ_GETFIELD_QUICK]) {
+		jobject this = LOCAL(0).operand.jref;
+		VALIDATE_REGISTER_TYPE(LOCAL(0).type, OBJECTREF);
+		// Continue as the quick getfield instruction:
+		ip++;
+		GETFIELD(this);
+	} else {
+		// The getfield instruction is not yet quickened; execute it by itself:
+		PUSH_LOCAL(0, OBJECTREF);
+	}
+}
+INS_END
+
+INS_BEGIN(f_thinj_iinc_goto) {
+	stackable* local = &LOCAL(OPERAND.iinc.index);
+	VALIDATE_REGISTER_TYPE(local->type, JAVAINT);
+	local->operand.jrenameint += OPERAND.iinc.delta;
+	// Continue as the goto instruction:
+	ip += 3;
+	BRANCH();
+}
+INS_END
+
+INS_BEGIN(f_thinj_iconst_iadd) {
+	jint value;
+	POP_INT(value);
+	PUSH_INT(value + OPERAND.value);
+	// Skip the iadd instruction:
+	ip++;
+}
+INS_END
+
+ILOAD_ILOAD_IFICMPINS(f_thinj_iload_iload_if_icmpeq, ==)
+ILOAD_ILOAD_IFICMPINS(f_thinj_iload_iload_if_icmpne, !=)
+ILOAD_ILOAD_IFICMPINS(f_thinj_iload_iload_if_icmplt, <)
+ILOAD_ILOAD_IFICMPINS(f_thinj_iload_iload_if_icmpge, >=)
+ILOAD_ILOAD_IFICMPINS(f_thinj_iload_iload_if_icmpgt, >)
+ILOAD_ILOAD_IFICMPINS(f_thinj_iload_iload_if_icmple, <=)
+
+/////////////////////////////////////////////////////
+// Superinstructions END
+/////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////
+// Quick instructions BEGIN
+// These replace the field, invoke and type check instructions the first time they are executed (see QUICKEN in
+// instructions.h). The operand is the resolved field, method or class, so no lookup is needed.
+/////////////////////////////////////////////////////
+
+INS_BEGIN(f_thinj_getstatic_quick) {
+	u2 address = OPERAND.field.address;
+	u1 size = OPERAND.field.size;
+	SKIP_OPERANDS(2);
+
+	// MSValue at highest addres; LSValue at lowest:
+	PUSH_STACKABLE(staticMemory[address]);
+
+	if (size == 2) {
+		PUSH_STACKABLE(staticMemory[address+1]);
+	}
+}
+INS_END
+
+INS_BEGIN(f_thinj_putstatic_quick) {
+	u2 address = OPERAND.field.address;
+	u1 size = OPERAND.field.size;
+	SKIP_OPERANDS(2);
+
+	// MSValue at highest addres; LSValue at lowest:
+	if (size == 2) {
+		POP_STACKABLE(staticMemory[address+1]);
+	}
+
+	POP_STACKABLE(staticMemory[address]);
+}
+INS_END
+
+INS_BEGIN(f_thinj_getfield_quick) {
+	jobject this;
+	POP_REF(this);
+	GETFIELD(this);
+}
+INS_END
+
+INS_BEGIN(f_thinj_putfield_quick) {
+	u2 address = OPERAND.field.address;
+	u1 size = OPERAND.field.size;
+	SKIP_OPERANDS(2);
+
+	stackable msValue;
+	POP_STACKABLE(msValue);
+	stackable lsValue;
+	if (size == 2) {
+		POP_STACKABLE(lsValue);
+	}
+	jobject this;
+	POP_REF(this);
+
+	if (this == NULL) {
+		INS_THROW(throwNullPointerException());
+	} else if (size == 1) {
+		PutField(this, address, &msValue);
+	} else {
+		PutField(this, address, &lsValue);
+		PutField(this, address+1, &msValue);
+	}
+}
+INS_END
+
+INS_CONTEXT_BEGIN(f_thinj_invokespecial_quick) {
+	const callStub* stub = OPERAND.stub;
+	// Skip the constant pool index:
+	context.programCounter += 2;
+
+	if (osIsObjectRefAtOffsetNull(stub->numberOfArguments)) {
+		throwNullPointerException();
+	} else {
+		stub->invoke(stub);
+	}
+}
+INS_CALL_END
+
+// Installed by the translation into threaded code, if no sub class overrides the method:
+INS_CONTEXT_BEGIN(f_thinj_invokevirtual_quick) {
+	const callStub* stub = OPERAND.stub;
+	// Skip the constant pool index:
+	context.programCounter += 2;
+
+	if (osIsObjectRefAtOffsetNull(stub->numberOfArguments)) {
+		throwNullPointerException();
+	} else {
+		stub->invoke(stub);
+	}
+}
+INS_CALL_END
+
+// An empty instance method, executed at the call site; only the arguments are discarded:
+INS_BEGIN(f_thinj_invoke_empty) {
+	u2 numberOfArguments = OPERAND.numberOfArguments;
+	SKIP_OPERANDS(2);
+
+	if (sp - sb < numberOfArguments) {
+		STACK_UNDERRUN();
+	}
+	sp -= numberOfArguments;
+	// The receiver is the first argument:
+	VALIDATE_REGISTER_TYPE(sp->type, OBJECTREF);
+	if (sp->operand.jref == NULL) {
+		INS_THROW(throwNullPointerException());
+	}
+}
+INS_END
+
+INS_CONTEXT_BEGIN(f_thinj_invokestatic_quick) {
+	// Skip the constant pool index:
+	context.programCounter += 2;
+	const callStub* stub = OPERAND.stub;
+	stub->invoke(stub);
+}
+INS_CALL_END
+
+INS_CONTEXT_BEGIN(f_thinj_anewarray_quick) {
+	u2 arrayClassId = OPERAND.classId;
+	// Skip the constant pool index:
+	context.programCounter += 2;
+
+	jint count = operandStackPopJavaInt();
+	if (count < 0) {
+		throwNegativeArraySizeException();
+	} else {
+		heapSetCompactionAllowed(executeDepth == 1);
+		jobject jref = jaNewObjectArray(count, arrayClassId);
+		heapSetCompactionAllowed(FALSE);
+		if (jref != NULL) {
+			operandStackPushObjectRef(jref);
+		}
+		// else: Out of mem has been thrown
+	}
+}
+INS_CONTEXT_END
+
+// The operand is the resolved class and the class of the last object which passed the test, so
+// repeated tests of objects of the same class are a single compare:
+INS_BEGIN(f_thinj_checkcast_quick) {
+	threadedOperand* operand = &OPERAND;
+	SKIP_OPERANDS(2);
+
+	// The reference stays on the stack:
+	jobject ref;
+	POP_REF(ref);
+	sp++;
+
+	if (ref != NULL) {
+		u2 classId_S = oaGetClassIdFromObject(ref);
+
+		if (classId_S != operand->typeCheck.lastClassId) {
+			if (CP_IsInstanceOf(classId_S, operand->typeCheck.classId)) {
+				operand->typeCheck.lastClassId = classId_S;
+			} else {
+				INS_THROW(throwClassCastException(classId_S, operand->typeCheck.classId));
+			}
+		}
+	}
+	//else: null is OK
+}
+INS_END
+
+INS_BEGIN(f_thinj_instanceof_quick) {
+	threadedOperand* operand = &OPERAND;
+	SKIP_OPERANDS(2);
+
+	jobject ref;
+	POP_REF(ref);
+
+	jint instanceOf = 0;
+
+	if (ref != NULL) {
+		u2 classId_S = oaGetClassIdFromObject(ref);
+
+		if (classId_S == operand->typeCheck.lastClassId) {
+			instanceOf = 1;
+		} else if (CP_IsInstanceOf(classId_S, operand->typeCheck.classId)) {
+			operand->typeCheck.lastClassId = classId_S;
+			instanceOf = 1;
+		}
+	}
+
+	PUSH_INT(instanceOf);
+}
+INS_END
+
+/////////////////////////////////////////////////////
+// Quick instructions END
+/////////////////////////////////////////////////////
+
 /////////////////////////////////////////////////////
 // Undefined instructions BEGIN
 /////////////////////////////////////////////////////
@@ -1367,16 +1681,6 @@ INS_UNDEFINED;
 //
 INS_END
 
-INS_BEGIN(f_tableswitch) //
-INS_UNDEFINED;
-//
-INS_END
-
-INS_BEGIN(f_lookupswitch) //
-INS_UNDEFINED;
-//
-INS_END
-
 INS_BEGIN(f_freturn) //
 INS_UNDEFINED;
 //
@@ -13,7 +13,163 @@
 typedef void (*instruction)(void);
 //#define INSTRUCTION(x) void x(void)
 
-#define INS_UNDEFINED inUndefinedInstruction(__FILE__, __LINE__)
+#define INS_UNDEFINED \
+	SAVE_CONTEXT(); \
+	inUndefinedInstruction(__FILE__, __LINE__)
+
+/**
+ * The interpreter in execute() keeps the program counter, stack pointer and frame pointer as
+ * pointers in the local (register) variables 'ip' (into the threaded code), 'sp' and 'fp' (into the
+ * stack). 'sb' and 'sl' are the base and the limit of the stack. The copies in 'context' are only
+ * valid after SAVE_CONTEXT; any call which might read or change the context (invoke, throw,
+ * allocation / GC, yield) shall be wrapped in SAVE_CONTEXT() ... LOAD_CONTEXT().
+ */
+#define LOAD_CONTEXT() \
+	do { \
+		ip = tcode + context.programCounter; \
+		sb = stack; \
+		sl = stack + STACK_SIZE; \
+		sp = sb + context.stackPointer; \
+		fp = sb + context.framePointer; \
+	} while (0)
+
+// The frame pointer is never changed by the register based instructions => not saved:
+#define SAVE_CONTEXT() \
+	do { \
+		context.programCounter = ip - tcode; \
+		context.stackPointer = sp - sb; \
+	} while (0)
+
+// The pre-decoded operand of the current instruction; 'ip' has been advanced past the opcode:
+#define OPERAND (ip[-1].operand)
+
+// Advance the program counter past the N operand bytes of the current instruction:
+#define SKIP_OPERANDS(N) (ip += (N))
+
+#define LOCAL(N) (fp[N])
+
+// VALIDATE_TYPE for the register based instructions; the context is saved first, so the fatal
+// diagnostics report the failing instruction:
+#define VALIDATE_REGISTER_TYPE(TYPE, EXPECT_TYPE) \
+	do { \
+		if ((TYPE) != (EXPECT_TYPE)) { \
+			SAVE_CONTEXT(); \
+			VALIDATE_TYPE(TYPE, EXPECT_TYPE); \
+		} \
+	} while (0)
+
+#define STACK_OVERFLOW() \
+	do { \
+		SAVE_CONTEXT(); \
+		consout("stack overflow: %d", (int) (sp - sb)); \
+		jvmexit(1); \
+	} while (0)
+
+#define PUSH_STACKABLE(ST) \
+	do { \
+		if (sp >= sl) { \
+			STACK_OVERFLOW(); \
+		} \
+		*sp++ = (ST); \
+	} while (0)
+
+#define PUSH_TYPED(FIELD, VALUE, TYPE) \
+	do { \
+		if (sp >= sl) { \
+			STACK_OVERFLOW(); \
+		} \
+		sp->operand.FIELD = (VALUE); \
+		sp->type = TYPE; \
+		sp++; \
+	} while (0)
+
+#define PUSH_INT(VALUE) PUSH_TYPED(jrenameint, VALUE, JAVAINT)
+#define PUSH_REF(VALUE) PUSH_TYPED(jref, VALUE, OBJECTREF)
+
+// LSWord first, then MSWord:
+#define PUSH_LONG(VALUE) \
+	do { \
+		jlong __l = (VALUE); \
+		PUSH_INT((jint) (__l & 0xffffffff)); \
+		PUSH_INT((jint) ((__l >> 32) & 0xffffffff)); \
+	} while (0)
+
+#define STACK_UNDERRUN() \
+	do { \
+		SAVE_CONTEXT(); \
+		consout("Operand Stack underrun: %04x\n", (int) (sp - sb)); \
+		jvmexit(1); \
+	} while (0)
+
+#define POP_STACKABLE(ST) \
+	do { \
+		if (sp > sb) { \
+			(ST) = *--sp; \
+		} else { \
+			STACK_UNDERRUN(); \
+		} \
+	} while (0)
+
+#define DISCARD_STACKABLE() \
+	do { \
+		if (sp > sb) { \
+			--sp; \
+		} else { \
+			STACK_UNDERRUN(); \
+		} \
+	} while (0)
+
+#define POP_TYPED(VALUE, FIELD, TYPE) \
+	do { \
+		if (sp > sb) { \
+			--sp; \
+			VALIDATE_REGISTER_TYPE(sp->type, TYPE); \
+			(VALUE) = sp->operand.FIELD; \
+		} else { \
+			STACK_UNDERRUN(); \
+		} \
+	} while (0)
+
+#define POP_INT(VALUE) POP_TYPED(VALUE, jrenameint, JAVAINT)
+#define POP_REF(VALUE) POP_TYPED(VALUE, jref, OBJECTREF)
+
+#define POP_LONG(VALUE) \
+	do { \
+		jint __ms; \
+		jint __ls; \
+		POP_INT(__ms); \
+		POP_INT(__ls); \
+		(VALUE) = (((jlong) __ms) << 32) | (__ls & 0xffffffff); \
+	} while (0)
+
+#define PUSH_LOCAL(N, TYPE) \
+	do { \
+		stackable __st = LOCAL(N); \
+		VALIDATE_REGISTER_TYPE(__st.type, TYPE); \
+		PUSH_STACKABLE(__st); \
+	} while (0)
+
+#define POP_LOCAL(N, TYPE) \
+	do { \
+		stackable __st; \
+		POP_STACKABLE(__st); \
+		VALIDATE_REGISTER_TYPE(__st.type, TYPE); \
+		LOCAL(N) = __st; \
+	} while (0)
+
+// Branch to TARGET. Backward branches are safepoints:
+#define BRANCH_TO(TARGET) \
+	do { \
+		threadedInstruction* __target = (TARGET); \
+		if (__target < ip) { \
+			ip = __target; \
+			goto pollSafepoint; \
+		} \
+		ip = __target; \
+	} while (0)
+
+// Branch to the pre-decoded target of the current instruction:
+#define BRANCH() BRANCH_TO(OPERAND.target)
 
 #define INS_BEGIN(X) lbl_##X:  { \
 	/***/
@@ -22,18 +178,196 @@ typedef void (*instruction)(void);
         goto nextInstruction; \
 }
 
-#define IFINS(NAME, CONDITION) \
+/**
+ * Instructions implemented by the context based functions (invoke, return, allocation, ...) are
+ * wrapped in these macros instead of INS_BEGIN / INS_END:
+ */
+#define INS_CONTEXT_BEGIN(X) lbl_##X:  { \
+	SAVE_CONTEXT(); \
+	context.exceptionThrown = FALSE; \
+	/***/
+
+// The instruction might have thrown an exception, thereby popping frames:
+#define INS_CONTEXT_END \
+        LOAD_CONTEXT(); \
+        goto checkReturn; \
+}
+
+// Invokes and returns end here; these are safepoints where a thread switch might happen:
+#define INS_CALL_END \
+        LOAD_CONTEXT(); \
+        goto pollSafepoint; \
+}
+
+/**
+ * Throw an exception from an instruction using the registers:
+ */
+#define INS_THROW(THROW_CALL) \
+	do { \
+		SAVE_CONTEXT(); \
+		context.exceptionThrown = FALSE; \
+		THROW_CALL; \
+		LOAD_CONTEXT(); \
+		goto checkReturn; \
+	} while (0)
+
+#define IFINS(NAME, OPERATOR) \
 		INS_BEGIN(NAME)  \
-			s2 offset = getS2FromCode();\
-			\
-			if (CONDITION) { \
-				context.programCounter -= 3;\
-				context.programCounter += offset; \
+			jint value; \
+			POP_INT(value); \
+			if (value OPERATOR 0) { \
+				BRANCH(); \
+			} else { \
+				SKIP_OPERANDS(2); \
 			} \
 		INS_END
 
+// Note! Left (value1) is pushed first and popped last:
+#define IFICMPINS(NAME, OPERATOR) \
+		INS_BEGIN(NAME)  \
+			jint value1; \
+			jint value2; \
+			POP_INT(value2); \
+			POP_INT(value1); \
+			if (value1 OPERATOR value2) { \
+				BRANCH(); \
+			} else { \
+				SKIP_OPERANDS(2); \
+			} \
+		INS_END
+
+#define IFACMPINS(NAME, OPERATOR) \
+		INS_BEGIN(NAME)  \
+			jobject value1; \
+			jobject value2; \
+			POP_REF(value2); \
+			POP_REF(value1); \
+			if (value1 OPERATOR value2) { \
+				BRANCH(); \
+			} else { \
+				SKIP_OPERANDS(2); \
+			} \
+		INS_END
+
+#define IFNULLINS(NAME, OPERATOR) \
+		INS_BEGIN(NAME)  \
+			jobject value; \
+			POP_REF(value); \
+			if (value OPERATOR NULL) { \
+				BRANCH(); \
+			} else { \
+				SKIP_OPERANDS(2); \
+			} \
+		INS_END
+
+/**
+ * iload a; iload b; if_icmp<cond> as a single instruction. The locals and the distance to the
+ * if_icmp<cond> instruction are found in the operand of the superinstruction:
+ */
+#define ILOAD_ILOAD_IFICMPINS(NAME, OPERATOR) \
+		INS_BEGIN(NAME)  \
+			const stackable* local1 = &LOCAL(OPERAND.icmp.local1); \
+			const stackable* local2 = &LOCAL(OPERAND.icmp.local2); \
+			VALIDATE_REGISTER_TYPE(local1->type, JAVAINT); \
+			VALIDATE_REGISTER_TYPE(local2->type, JAVAINT); \
+			/* Continue as the if_icmp<cond> instruction: */ \
+			ip += OPERAND.icmp.branchOffset; \
+			if (local1->operand.jrenameint OPERATOR local2->operand.jrenameint) { \
+				BRANCH(); \
+			} else { \
+				SKIP_OPERANDS(2); \
+			} \
+		INS_END
+
+/**
+ * Replace the current instruction by its quick variant OPCODE. The operand shall be written before
+ * the instruction is replaced:
+ */
+#define QUICKEN(OPCODE) (ip[-1].handler = jumpTable[OPCODE])
+
+/**
+ * Replace the current field instruction by its quick variant OPCODE holding the resolved field, and
+ * execute the quick variant:
+ */
+#define QUICKEN_FIELD(OPCODE, ADDRESS, SIZE) \
+	do { \
+		if ((SIZE) != 1 && (SIZE) != 2) { \
+			SAVE_CONTEXT(); \
+			consout("No support for size != 1 or 2: %d\n", (SIZE)); \
+			jvmexit(1); \
+		} \
+		OPERAND.field.address = (ADDRESS); \
+		OPERAND.field.size = (SIZE); \
+		QUICKEN(OPCODE); \
+		ip--; \
+		goto nextInstruction; \
+	} while (0)
+
+/**
+ * Replace the current invoke instruction by its quick variant OPCODE holding the call stub of the
+ * resolved method MIC:
+ */
+#define QUICKEN_METHOD(OPCODE, MIC) \
+	do { \
+		OPERAND.stub = cpGetCallStub(MIC); \
+		QUICKEN(OPCODE); \
+	} while (0)
+
+/**
+ * Replace the current checkcast or instanceof instruction by its quick variant OPCODE holding the
+ * resolved class CLASSID, and execute the quick variant. An object of the class itself always
+ * passes the test, so the class is a valid initial value of the last passed class:
+ */
+#define QUICKEN_TYPE_CHECK(OPCODE, CLASSID) \
+	do { \
+		OPERAND.typeCheck.classId = (CLASSID); \
+		OPERAND.typeCheck.lastClassId = (CLASSID); \
+		QUICKEN(OPCODE); \
+		ip--; \
+		goto nextInstruction; \
+	} while (0)
+
+/**
+ * Replace the current invoke instruction by the intrinsic instruction executing the method MIC at
+ * the call site, if any, and execute the intrinsic instruction; see tcGetIntrinsic():
+ */
+#define QUICKEN_INTRINSIC(MIC) \
+	do { \
+		OPCODE __intrinsic = tcGetIntrinsic((MIC), &OPERAND); \
+		if (__intrinsic != OP_THINJ_UNDEFINED) { \
+			QUICKEN(__intrinsic); \
+			ip--; \
+			goto nextInstruction; \
+		} \
+	} while (0)
+
+/**
+ * The body of the quick getfield, reading from the object THIS. The operand of the current
+ * instruction is the resolved field:
+ */
+#define GETFIELD(THIS) \
+	do { \
+		jobject __this = (THIS); \
+		u2 address = OPERAND.field.address; \
+		u1 size = OPERAND.field.size; \
+		SKIP_OPERANDS(2); \
+		if (__this != NULL) { \
+			stackable * value = GetField(__this, address); \
+			PUSH_STACKABLE(*value); \
+			if (size == 2) { \
+				value = GetField(__this, address + 1); \
+				PUSH_STACKABLE(*value); \
+			} \
+		} else { \
+			INS_THROW(throwNullPointerException()); \
+		} \
+	} while (0)
+
 //cat instruction1.c | grep INS_BEGIN | sed 's/INS_BEGIN(/\&\&lbl_/g' | sed 's/).*/,/g' > dims
-//cat instruction1.c | grep IFINS | sed 's/IFINS(/\&\&lbl_/g' | sed 's/,.*/,/g'  >> dims
+//cat instruction1.c | grep INS_CONTEXT_BEGIN | sed 's/INS_CONTEXT_BEGIN(/\&\&lbl_/g' | sed 's/).*/,/g' >> dims
+//cat instruction1.c | grep IF.*INS | sed 's/IF.*INS(/\&\&lbl_/g' | sed 's/,.*/,/g'  >> dims
+// Opcodes 0xcb - 0xd3 are the superinstructions and 0xd4 - 0xde the quick instructions; see
+// threadedcode.h
 
 
 #define JUMP_TABLE void *jumpTable[] = { \
@@ -240,26 +574,26 @@ typedef void (*instruction)(void);
 	/* 200 (0xc8) */&&lbl_f_goto_w, \
 	/* 201 (0xc9) */&&lbl_f_jsr_w, \
 	/* 202 (0xca) */&&lbl_f_breakpoint, \
-	/* 203 (0xcb) */&&lbl_f_thinj_undefined, \
-	/* 204 (0xcc) */&&lbl_f_thinj_undefined, \
-	/* 205 (0xcd) */&&lbl_f_thinj_undefined, \
-	/* 206 (0xce) */&&lbl_f_thinj_undefined, \
-	/* 207 (0xcf) */&&lbl_f_thinj_undefined, \
-	/* 208 (0xd0) */&&lbl_f_thinj_undefined, \
-	/* 209 (0xd1) */&&lbl_f_thinj_undefined, \
-	/* 210 (0xd2) */&&lbl_f_thinj_undefined, \
-	/* 211 (0xd3) */&&lbl_f_thinj_undefined, \
-	/* 212 (0xd4) */&&lbl_f_thinj_undefined, \
-	/* 213 (0xd5) */&&lbl_f_thinj_undefined, \
-	/* 214 (0xd6) */&&lbl_f_thinj_undefined, \
-	/* 215 (0xd7) */&&lbl_f_thinj_undefined, \
-	/* 216 (0xd8) */&&lbl_f_thinj_undefined, \
-	/* 217 (0xd9) */&&lbl_f_thinj_undefined, \
-	/* 218 (0xda) */&&lbl_f_thinj_undefined, \
-	/* 219 (0xdb) */&&lbl_f_thinj_undefined, \
-	/* 220 (0xdc) */&&lbl_f_thinj_undefined, \
-	/* 221 (0xdd) */&&lbl_f_thinj_undefined, \
-	/* 222 (0xde) */&&lbl_f_thinj_undefined, \
+	/* 203 (0xcb) */&&lbl_f_thinj_aload_0_getfield, \
+	/* 204 (0xcc) */&&lbl_f_thinj_iinc_goto, \
+	/* 205 (0xcd) */&&lbl_f_thinj_iconst_iadd, \
+	/* 206 (0xce) */&&lbl_f_thinj_iload_iload_if_icmpeq, \
+	/* 207 (0xcf) */&&lbl_f_thinj_iload_iload_if_icmpne, \
+	/* 208 (0xd0) */&&lbl_f_thinj_iload_iload_if_icmplt, \
+	/* 209 (0xd1) */&&lbl_f_thinj_iload_iload_if_icmpge, \
+	/* 210 (0xd2) */&&lbl_f_thinj_iload_iload_if_icmpgt, \
+	/* 211 (0xd3) */&&lbl_f_thinj_iload_iload_if_icmple, \
+	/* 212 (0xd4) */&&lbl_f_thinj_getstatic_quick, \
+	/* 213 (0xd5) */&&lbl_f_thinj_putstatic_quick, \
+	/* 214 (0xd6) */&&lbl_f_thinj_getfield_quick, \
+	/* 215 (0xd7) */&&lbl_f_thinj_putfield_quick, \
+	/* 216 (0xd8) */&&lbl_f_thinj_invokespecial_quick, \
+	/* 217 (0xd9) */&&lbl_f_thinj_invokestatic_quick, \
+	/* 218 (0xda) */&&lbl_f_thinj_checkcast_quick, \
+	/* 219 (0xdb) */&&lbl_f_thinj_instanceof_quick, \
+	/* 220 (0xdc) */&&lbl_f_thinj_invokevirtual_quick, \
+	/* 221 (0xdd) */&&lbl_f_thinj_invoke_empty, \
+	/* 222 (0xde) */&&lbl_f_thinj_anewarray_quick, \
 	/* 223 (0xdf) */&&lbl_f_thinj_undefined, \
 	/* 224 (0xe0) */&&lbl_f_thinj_undefined, \
 	/* 225 (0xe1) */&&lbl_f_thinj_undefined, \
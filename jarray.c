@@ -103,7 +103,14 @@ void SetObjectArrayElement(jarray array, size_t index, jobject value) {
 	HEAP_VALIDATE;
 //	consoutli("index = %d, array=0x%08x\n", index, getHeader(array));
 
-	SET_ARRAY_ELEMENT(array, index, value, jobject);
+	jobject* p = (jobject*) GetPointerToArrayPosition(array, index);
+	if (p != NULL) {
+		jobject oldValue = p[index];
+		p[index] = value;
+		heapWriteBarrier(array, oldValue, value);
+	}
+
+	HEAP_VALIDATE;
 }
 
 size_t GetArrayLength(jarray array) {
@@ -162,8 +169,21 @@ void GetByteArrayRegion(jbyteArray array, jsize start, jsize len, jbyte *buf) {
 }
 
 jarray NewObjectArray(jint count, u2 elementClassId, jobject init) {
-	HEAP_VALIDATE;
 	u2 arrayClassId = getArrayClassIdForElementClassId(elementClassId);
+	jarray array = jaNewObjectArray(count, arrayClassId);
+
+	if (array != NULL && init != NULL) {
+		jint i;
+		for (i = 0; i < count; i++) {
+			SetObjectArrayElement(array, i, init);
+		}
+	}
+
+	return array;
+}
+
+jarray jaNewObjectArray(jint count, u2 arrayClassId) {
+	HEAP_VALIDATE;
 	size_t size = sizeof(jobject);
 	// The payload size:
 	u2 payloadSize = count * size;
@@ -176,9 +196,10 @@ jarray NewObjectArray(jint count, u2 elementClassId, jobject init) {
 		throwOutOfMemoryError();
 	} else {
 		InitArray(array, count); //, elementClassId);
+		jobject* elements = (jobject*) jaGetArrayPayLoad(array);
 		jint i;
-		for (i = 0; i < count; i++) {
-			SetObjectArrayElement(array, i, init);
+		for (i = 0; i < count && elements != NULL; i++) {
+			elements[i] = NULL;
 		}
 	}
 
@@ -206,7 +227,7 @@ jint GetLongArrayElement(jarray array, size_t index) {
 	GET_ARRAY_ELEMENT(array, index, jlong);
 }
 
-static jarray NewPrimitiveArray(CLASS_TYPE classType, size_t len, size_t elementSize) {
+static jarray NewPrimitiveArray(CLASS_TYPE classType, size_t len, size_t elementSize, BOOL tenured) {
 	HEAP_VALIDATE;
 	u2 arrayClassId = getClassIdForClassType(classType);
 
@@ -214,7 +235,12 @@ static jarray NewPrimitiveArray(CLASS_TYPE classType, size_t len, size_t element
 
 	size_t alignedSizeInBytes = GetAlignedArraySize(payloadSize) * sizeof(align_t);
 
-	jarray array = heapAllocObjectByByteSize(alignedSizeInBytes, arrayClassId);
+	jarray array;
+	if (tenured) {
+		array = heapAllocTenuredObjectByByteSize(alignedSizeInBytes, arrayClassId);
+	} else {
+		array = heapAllocObjectByByteSize(alignedSizeInBytes, arrayClassId);
+	}
 
 	if (array != NULL) {
 		InitArray(array, len);//, 0);
@@ -226,23 +252,27 @@ static jarray NewPrimitiveArray(CLASS_TYPE classType, size_t len, size_t element
 }
 
 jcharArray NewCharArray(size_t len) {
-	return NewPrimitiveArray(CT_CHAR_ARRAY, len, sizeof(jchar));
+	return NewPrimitiveArray(CT_CHAR_ARRAY, len, sizeof(jchar), FALSE);
 }
 
 jbooleanArray NewBooleanArray(size_t len) {
-	return NewPrimitiveArray(CT_BOOLEAN_ARRAY, len, sizeof(jboolean));
+	return NewPrimitiveArray(CT_BOOLEAN_ARRAY, len, sizeof(jboolean), FALSE);
 }
 
 jbyteArray NewByteArray(size_t len) {
-	return NewPrimitiveArray(CT_BYTE_ARRAY, len, sizeof(jbyte));
+	return NewPrimitiveArray(CT_BYTE_ARRAY, len, sizeof(jbyte), FALSE);
+}
+
+jbyteArray jaNewTenuredByteArray(size_t len) {
+	return NewPrimitiveArray(CT_BYTE_ARRAY, len, sizeof(jbyte), TRUE);
 }
 
 jintArray NewIntArray(size_t len) {
-	return NewPrimitiveArray(CT_INT_ARRAY, len, sizeof(jint));
+	return NewPrimitiveArray(CT_INT_ARRAY, len, sizeof(jint), FALSE);
 }
 
 jlongArray NewLongArray(size_t len) {
-	return NewPrimitiveArray(CT_LONG_ARRAY, len, sizeof(jlong));
+	return NewPrimitiveArray(CT_LONG_ARRAY, len, sizeof(jlong), FALSE);
 }
 
 void SetBooleanArrayElement(jarray array, size_t index, BOOL value) {
@@ -43,4 +43,19 @@ size_t GetAlignedArraySize(size_t payloadSize);
  */
 void* jaGetArrayPayLoad(jarray array);
 
+/**
+ * This function allocates an Object array with all elements set to null
+ * \param count The number of elements in the array
+ * \param arrayClassId The class id of the array class, see getArrayClassIdForElementClassId()
+ * \return The array, or NULL if out of memory, in which case an OutOfMemoryError has been thrown
+ */
+jarray jaNewObjectArray(jint count, u2 arrayClassId);
+
+/**
+ * This function allocates a byte array, which is never moved by the garbage collector
+ * \param len The number of elements in the array
+ * \return The array, or NULL if out of memory, in which case an OutOfMemoryError has been thrown
+ */
+jbyteArray jaNewTenuredByteArray(size_t len);
+
 #endif /* JARRAY_H_ */
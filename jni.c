@@ -50,7 +50,7 @@ void call_instance_method(jobject referencedClassObject, u2 linkId) {
  * \return A pointer to the stackable
  */
 static stackable* GetStaticFieldStackable(jclass cls, u2 linkId, stackType type) {
-	u2 classId = GetIntField(cls, LINK_ID_java_lang_Class_aClassId_I);
+	u2 classId = getClassIdOfJavaLangClass(cls);
 	const fieldInClass* fic = getFieldInClassbyLinkId(classId, linkId);
 
 	stackable* val = GetStaticField(fic->address);
@@ -85,7 +85,7 @@ void SetObjectField(jobject obj, u2 linkId, jobject value) {
 }
 
 void SetStaticObjectField(jclass cls, u2 linkId, jobject value) {
-	u2 classId = GetIntField(cls, LINK_ID_java_lang_Class_aClassId_I);
+	u2 classId = getClassIdOfJavaLangClass(cls);
 	const fieldInClass* fic = getFieldInClassbyLinkId(classId, linkId);
 
 	stackable val;
@@ -164,7 +164,7 @@ jstring NewString(const jchar *value) {
 }
 
 jobject AllocObject(jclass cls) {
-	u2 classId = GetIntField(cls, LINK_ID_java_lang_Class_aClassId_I);
+	u2 classId = getClassIdOfJavaLangClass(cls);
 	u2 size;
 	getClassSize(classId, &size);
 	return heapAllocObjectByStackableSize(size, classId);
@@ -17,7 +17,11 @@ void PutField(jobject obj, u2 address, stackable* value) {
 	if (obj != NULL) {
 		stackable* objectPayload = (stackable*) GetObjectPayload(obj);
 		objectPayload += address;
+		jobject oldValue = objectPayload->type == OBJECTREF ? objectPayload->operand.jref : NULL;
 		*objectPayload = *value;
+		if (value->type == OBJECTREF || oldValue != NULL) {
+			heapWriteBarrier(obj, oldValue, value->type == OBJECTREF ? value->operand.jref : NULL);
+		}
 	} else {
 		throwNullPointerException();
 	}
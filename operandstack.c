@@ -37,7 +37,8 @@ static size_t sGetStackSizeInBytes() {
 }
 
 jbyteArray osAllocateStack(void) {
-	jbyteArray stackObject = NewByteArray(sGetStackSizeInBytes());
+	// The stack is referenced directly by the interpreter, so it must never move:
+	jbyteArray stackObject = jaNewTenuredByteArray(sGetStackSizeInBytes());
 
 	return stackObject;
 }
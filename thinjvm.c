@@ -11,8 +11,9 @@
 #include "frame.h"
 #include "heap.h"
 
-void thinjvm_run(align_t* heap, size_t heapSize, size_t stackSize) {
-	resetVM(heap, heapSize, stackSize);
+void thinjvm_run(align_t* heap, size_t heapSize, size_t stackSize, align_t* tables,
+		size_t tablesSize) {
+	resetVM(heap, heapSize, stackSize, tables, tablesSize);
 
 	push_frame(0, startClassIndex, startAddress, TRUE);
 
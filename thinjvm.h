@@ -19,11 +19,21 @@ extern "C" {
 
 /**
  * This function starts the VM and will never return.
+ *
+ * The tables built by the VM are kept apart from the Java objects, in the memory area 'tables'.
+ * The threaded code is the largest one: sizeof(threadedInstruction) bytes (8 on a 32 bit target,
+ * 16 on a 64 bit target) per byte of byte code in the application, see threadedcode.h. The inline
+ * caches, the vtables and itables, the call stubs and the constant, type and field tables take a
+ * few bytes per call site, method, class and constant. The VM exits with "Out of memory; can't
+ * alloc ... for VM tables", if the area can't hold them; the message tells the size used so far.
  * \param heap A pointer to the memory area where the heap will be placed
  * \param heapSize The size of the heap area (in chunks of align_t)
  * \param stackSize The size of the stack (in bytes)
+ * \param tables A pointer to the memory area where the tables of the VM will be placed
+ * \param tablesSize The size of the tables area (in chunks of align_t)
  */
-void thinjvm_run(align_t* heap, size_t heapSize, size_t stackSize);
+void thinjvm_run(align_t* heap, size_t heapSize, size_t stackSize, align_t* tables,
+		size_t tablesSize);
 
 /**
  * This function shall exit the vm
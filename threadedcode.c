@@ -0,0 +1,381 @@
+/*
+ * threadedcode.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "types.h"
+#include "console.h"
+#include "config.h"
+#include "constantpool.h"
+#include "heap.h"
+#include "vtable.h"
+#include "threadedcode.h"
+
+/**
+ * The length of each instruction including operands; 0 means variable length:
+ */
+static const u1 instructionLength[256] = {
+	/* 0x00 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	/* 0x10 */ 2, 3, 2, 3, 3, 2, 2, 2, 2, 2, 1, 1, 1, 1, 1, 1,
+	/* 0x20 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	/* 0x30 */ 1, 1, 1, 1, 1, 1, 2, 2, 2, 2, 2, 1, 1, 1, 1, 1,
+	/* 0x40 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	/* 0x50 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	/* 0x60 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	/* 0x70 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	/* 0x80 */ 1, 1, 1, 1, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	/* 0x90 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 3, 3, 3, 3, 3, 3, 3,
+	/* 0xa0 */ 3, 3, 3, 3, 3, 3, 3, 3, 3, 2, 0, 0, 1, 1, 1, 1,
+	/* 0xb0 */ 1, 1, 3, 3, 3, 3, 3, 3, 3, 5, 5, 3, 2, 3, 1, 1,
+	/* 0xc0 */ 3, 3, 1, 1, 0, 4, 3, 3, 5, 5, 1, 1, 1, 1, 1, 1,
+	/* 0xd0 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	/* 0xe0 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	/* 0xf0 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+};
+
+// The threaded code; NULL until translated:
+static threadedInstruction* threadedCode = NULL;
+
+// The inline caches of all invokevirtual and invokeinterface call sites, and the next unused one:
+static inlineCache* inlineCaches = NULL;
+static inlineCache* nextInlineCache = NULL;
+
+static u2 sGetU2(codeIndex pc) {
+	return (u2) ((code[pc] << 8) | code[pc + 1]);
+}
+
+static s4 sGetS4(codeIndex pc) {
+	return (s4) ((((u4) code[pc]) << 24) | (((u4) code[pc + 1]) << 16) | (((u4) code[pc + 2]) << 8)
+			| ((u4) code[pc + 3]));
+}
+
+u2 tcGetInstructionLength(codeIndex methodStart, codeIndex pc) {
+	u1 opcode = code[pc];
+	u2 length = instructionLength[opcode];
+
+	if (length == 0) {
+		// The operands of the switches are aligned at 4 bytes relative to the method start:
+		codeIndex operands = pc + 1 + ((4 - ((pc + 1 - methodStart) & 3)) & 3);
+		if (opcode == OP_TABLESWITCH) {
+			// default, low, high, jump offsets:
+			s4 low = sGetS4(operands + 4);
+			s4 high = sGetS4(operands + 8);
+			length = operands - pc + 12 + (high - low + 1) * 4;
+		} else if (opcode == OP_LOOKUPSWITCH) {
+			// default, npairs, match-offset pairs:
+			s4 npairs = sGetS4(operands + 4);
+			length = operands - pc + 8 + npairs * 8;
+		} else {
+			// wide:
+			length = code[pc + 1] == OP_IINC ? 6 : 4;
+		}
+	}
+
+	return length;
+}
+
+/**
+ * This method decodes the operand of the instruction at code[pc]
+ */
+static void sDecodeOperand(codeIndex pc, threadedOperand* operand) {
+	u1 opcode = code[pc];
+
+	if ((opcode >= OP_IFEQ && opcode <= OP_GOTO) || opcode == OP_IFNULL || opcode == OP_IFNONNULL) {
+		operand->target = &threadedCode[(codeIndex) (pc + (s2) sGetU2(pc + 1))];
+	} else {
+		switch (opcode) {
+		case OP_BIPUSH:
+			operand->value = (s1) code[pc + 1];
+			break;
+		case OP_SIPUSH:
+			operand->value = (s2) sGetU2(pc + 1);
+			break;
+		case OP_ILOAD:
+		case OP_LLOAD:
+		case OP_ALOAD:
+		case OP_ISTORE:
+		case OP_LSTORE:
+		case OP_ASTORE:
+			operand->index = code[pc + 1];
+			break;
+		case OP_IINC:
+			operand->iinc.index = code[pc + 1];
+			operand->iinc.delta = (s1) code[pc + 2];
+			break;
+		case OP_GETSTATIC:
+		case OP_PUTSTATIC:
+		case OP_GETFIELD:
+		case OP_PUTFIELD:
+		case OP_ANEWARRAY:
+		case OP_CHECKCAST:
+		case OP_INSTANCEOF:
+			operand->index = sGetU2(pc + 1);
+			break;
+		default:
+			// The instruction decodes its operands itself:
+			break;
+		}
+	}
+}
+
+/**
+ * This method decodes the operands of the tableswitch or lookupswitch instruction at code[pc] into
+ * the entries following the instruction; see threadedcode.h
+ * \param methodStart The address of the first instruction in the method
+ */
+static void sDecodeSwitch(codeIndex methodStart, codeIndex pc) {
+	threadedInstruction* ti = &threadedCode[pc];
+	// The operands of the switches are aligned at 4 bytes relative to the method start:
+	codeIndex operands = pc + 1 + ((4 - ((pc + 1 - methodStart) & 3)) & 3);
+
+	ti[1].operand.target = &threadedCode[(codeIndex) (pc + sGetS4(operands))];
+	if (code[pc] == OP_TABLESWITCH) {
+		s4 low = sGetS4(operands + 4);
+		s4 high = sGetS4(operands + 8);
+		ti[2].operand.value = low;
+		ti[3].operand.value = high;
+		s4 i;
+		for (i = 0; i <= high - low; i++) {
+			ti[4 + i].operand.target = &threadedCode[(codeIndex) (pc + sGetS4(operands + 12 + i * 4))];
+		}
+	} else {
+		s4 npairs = sGetS4(operands + 4);
+		ti[2].operand.value = npairs;
+		s4 i;
+		for (i = 0; i < npairs; i++) {
+			ti[3 + 2 * i].operand.value = sGetS4(operands + 8 + i * 8);
+			ti[4 + 2 * i].operand.target = &threadedCode[(codeIndex) (pc + sGetS4(operands + 12 + i * 8))];
+		}
+	}
+}
+
+/**
+ * This method returns the local variable index of the iload instruction at code[pc], or -1 if
+ * it isn't an iload instruction
+ */
+static int sGetIloadIndex(codeIndex pc) {
+	u1 opcode = code[pc];
+	int index;
+
+	if (opcode == OP_ILOAD) {
+		index = code[pc + 1];
+	} else if (opcode >= OP_ILOAD_0 && opcode <= OP_ILOAD_3) {
+		index = opcode - OP_ILOAD_0;
+	} else {
+		index = -1;
+	}
+
+	return index;
+}
+
+/**
+ * This method installs a superinstruction at the threaded code entry of pc, if the instructions
+ * starting at pc is a common sequence. Only the entry at pc is changed.
+ * \param methodStart The address of the first instruction in the method
+ * \param end The address after the last instruction in the method
+ */
+static void sFuse(void* const jumpTable[], codeIndex methodStart, codeIndex end, codeIndex pc) {
+	threadedInstruction* ti = &threadedCode[pc];
+	u1 opcode = code[pc];
+	codeIndex next = pc + tcGetInstructionLength(methodStart, pc);
+
+	if (next >= end) {
+		// No sequence:
+		return;
+	}
+
+	u1 nextOpcode = code[next];
+	if (opcode == OP_ALOAD_0 && nextOpcode == OP_GETFIELD) {
+		ti->handler = jumpTable[OP_THINJ_ALOAD_0_GETFIELD];
+	} else if (opcode == OP_IINC && nextOpcode == OP_GOTO) {
+		ti->handler = jumpTable[OP_THINJ_IINC_GOTO];
+	} else if (opcode >= OP_ICONST_M1 && opcode <= OP_ICONST_5 && nextOpcode == OP_IADD) {
+		ti->handler = jumpTable[OP_THINJ_ICONST_IADD];
+		ti->operand.value = opcode - OP_ICONST_M1 - 1;
+	} else if (sGetIloadIndex(pc) >= 0 && sGetIloadIndex(next) >= 0) {
+		codeIndex branch = next + tcGetInstructionLength(methodStart, next);
+		if (branch < end && code[branch] >= OP_IF_ICMPEQ && code[branch] <= OP_IF_ICMPLE) {
+			ti->operand.icmp.local1 = sGetIloadIndex(pc);
+			ti->operand.icmp.local2 = sGetIloadIndex(next);
+			ti->operand.icmp.branchOffset = branch - pc;
+			ti->handler = jumpTable[OP_THINJ_ILOAD_ILOAD_IF_ICMPEQ + code[branch] - OP_IF_ICMPEQ];
+		}
+	}
+}
+
+/**
+ * This method returns the only method the invokevirtual instruction at code[pc] can invoke, or NULL
+ * if the method is overridden by a sub class of the referenced class (class hierarchy analysis)
+ * \param mic The method containing the instruction
+ */
+static const methodInClass* sGetMonomorphicMethod(const methodInClass* mic, codeIndex pc) {
+	const memberReference* mref = lookupMethodReference(mic->classId, sGetU2(pc + 1));
+	const methodInClass* target = NULL;
+
+	if (getClassType(mref->referencedClassId) != CT_INTERFACE) {
+		int slot = vtGetSlot(mref->referencedClassId, mref->linkId);
+		if (slot >= 0) {
+			target = vtGetMonomorphicMethod(mref->referencedClassId, slot);
+		}
+	}
+
+	return target;
+}
+
+OPCODE tcGetIntrinsic(const methodInClass* mic, threadedOperand* operand) {
+	codeIndex pc = mic->codeOffset;
+	OPCODE intrinsic = OP_THINJ_UNDEFINED;
+
+	if (mic->nativeIndex > 0 || mic->numberOfArguments == 0) {
+		// Not an instance method with code:
+		return intrinsic;
+	}
+
+	if (mic->codeLength == 1 && code[pc] == OP_RETURN) {
+		intrinsic = OP_THINJ_INVOKE_EMPTY;
+	} else if (mic->codeLength == 5 && code[pc] == OP_ALOAD_0 && code[pc + 4] == OP_RETURN
+			&& code[pc + 1] == OP_INVOKESPECIAL) {
+		// A constructor only invoking the super constructor:
+		threadedOperand superOperand;
+		const methodInClass* superConstructor = getStaticMethodEntry(mic->classId, sGetU2(pc + 2));
+		if (superConstructor->numberOfArguments == 1
+				&& tcGetIntrinsic(superConstructor, &superOperand) == OP_THINJ_INVOKE_EMPTY) {
+			intrinsic = OP_THINJ_INVOKE_EMPTY;
+		}
+	} else if (mic->codeLength == 5 && mic->numberOfArguments == 1 && code[pc] == OP_ALOAD_0
+			&& code[pc + 1] == OP_GETFIELD) {
+		const memberReference* fref = &allConstantPools[mic->classId].fieldReferences[sGetU2(pc + 2)];
+		const fieldInClass* fic = getFieldInClassbyLinkId(fref->referencedClassId, fref->linkId);
+		u1 opcode = code[pc + 4];
+		if ((fic->size == 1 && (opcode == OP_IRETURN || opcode == OP_ARETURN))
+				|| (fic->size == 2 && opcode == OP_LRETURN)) {
+			operand->field.address = fic->address;
+			operand->field.size = fic->size;
+			intrinsic = OP_THINJ_GETFIELD_QUICK;
+		}
+	} else if (mic->codeLength == 6 && mic->numberOfArguments == 2 && code[pc] == OP_ALOAD_0
+			&& (code[pc + 1] == OP_ILOAD_1 || code[pc + 1] == OP_ALOAD_1)
+			&& code[pc + 2] == OP_PUTFIELD && code[pc + 5] == OP_RETURN) {
+		const memberReference* fref = &allConstantPools[mic->classId].fieldReferences[sGetU2(pc + 3)];
+		const fieldInClass* fic = getFieldInClassbyLinkId(fref->referencedClassId, fref->linkId);
+		if (fic->size == 1) {
+			operand->field.address = fic->address;
+			operand->field.size = fic->size;
+			intrinsic = OP_THINJ_PUTFIELD_QUICK;
+		}
+	}
+
+	if (intrinsic == OP_THINJ_INVOKE_EMPTY) {
+		operand->numberOfArguments = mic->numberOfArguments;
+	}
+
+	return intrinsic;
+}
+
+/**
+ * This method returns the number of polymorphic invokevirtual and invokeinterface call sites in a
+ * method
+ */
+static int sCountCallSites(const methodInClass* mic) {
+	codeIndex pc = mic->codeOffset;
+	codeIndex end = mic->codeOffset + mic->codeLength;
+	int count = 0;
+
+	while (pc < end) {
+		if ((code[pc] == OP_INVOKEVIRTUAL && sGetMonomorphicMethod(mic, pc) == NULL)
+				|| code[pc] == OP_INVOKEINTERFACE) {
+			count++;
+		}
+		pc += tcGetInstructionLength(mic->codeOffset, pc);
+	}
+
+	return count;
+}
+
+/**
+ * This method translates a single method into threaded code
+ */
+static void sTranslateMethod(void* const jumpTable[], const methodInClass* mic) {
+	codeIndex pc = mic->codeOffset;
+	codeIndex end = mic->codeOffset + mic->codeLength;
+
+	while (pc < end) {
+		threadedInstruction* ti = &threadedCode[pc];
+		u1 opcode = code[pc];
+		if (opcode >= OP_THINJ_ALOAD_0_GETFIELD && opcode <= OP_THINJ_ANEWARRAY_QUICK) {
+			// Not a valid byte code; these opcodes are reserved for the superinstructions and the
+			// quick instructions:
+			opcode = OP_THINJ_UNDEFINED;
+		}
+		ti->handler = jumpTable[opcode];
+		sDecodeOperand(pc, &ti->operand);
+		if (opcode == OP_TABLESWITCH || opcode == OP_LOOKUPSWITCH) {
+			sDecodeSwitch(mic->codeOffset, pc);
+		}
+		if (opcode == OP_INVOKEVIRTUAL || opcode == OP_INVOKEINTERFACE) {
+			const methodInClass* target = NULL;
+			if (opcode == OP_INVOKEVIRTUAL) {
+				target = sGetMonomorphicMethod(mic, pc);
+			}
+
+			if (target != NULL) {
+				// Not overridden; invoke without looking at the receiver class, or execute it
+				// at the call site:
+				OPCODE intrinsic = tcGetIntrinsic(target, &ti->operand);
+				if (intrinsic != OP_THINJ_UNDEFINED) {
+					ti->handler = jumpTable[intrinsic];
+				} else {
+					ti->handler = jumpTable[OP_THINJ_INVOKEVIRTUAL_QUICK];
+					ti->operand.stub = cpGetCallStub(target);
+				}
+			} else {
+				ti->operand.cache = nextInlineCache++;
+				icInit(ti->operand.cache, mic->classId, sGetU2(pc + 1));
+			}
+		}
+
+		pc += tcGetInstructionLength(mic->codeOffset, pc);
+	}
+
+	// Install superinstructions:
+	pc = mic->codeOffset;
+	while (pc < end) {
+		sFuse(jumpTable, mic->codeOffset, end, pc);
+		pc += tcGetInstructionLength(mic->codeOffset, pc);
+	}
+}
+
+threadedInstruction* tcGetThreadedCode(void* const jumpTable[]) {
+	if (threadedCode == NULL) {
+		threadedCode = heapAllocPermanent(codeSize * sizeof(threadedInstruction));
+
+		int callSites = 0;
+		int i;
+		for (i = 0; i < numberOfAllMethodsInAllClasses; i++) {
+			const methodInClass* mic = &allMethodsInAllClasses[i];
+			if (mic->nativeIndex == 0 && mic->codeLength > 0) {
+				callSites += sCountCallSites(mic);
+			}
+		}
+		if (callSites > 0) {
+			inlineCaches = heapAllocPermanent(callSites * sizeof(inlineCache));
+		}
+		nextInlineCache = inlineCaches;
+
+		for (i = 0; i < numberOfAllMethodsInAllClasses; i++) {
+			const methodInClass* mic = &allMethodsInAllClasses[i];
+			if (mic->nativeIndex == 0 && mic->codeLength > 0) {
+				sTranslateMethod(jumpTable, mic);
+			}
+		}
+	}
+
+	return threadedCode;
+}
+
+void tcReset(void) {
+	threadedCode = NULL;
+	inlineCaches = NULL;
+	nextInlineCache = NULL;
+}
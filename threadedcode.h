@@ -0,0 +1,197 @@
+/*
+ * threadedcode.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef THREADEDCODE_H_
+#define THREADEDCODE_H_
+
+#include "types.h"
+#include "constantpool.h"
+#include "inlinecache.h"
+
+/**
+ * Opcodes referred to by the translation into threaded code:
+ */
+typedef enum {
+	OP_ICONST_M1 = 0x02,
+	OP_ICONST_5 = 0x08,
+	OP_BIPUSH = 0x10,
+	OP_SIPUSH = 0x11,
+	OP_ILOAD = 0x15,
+	OP_LLOAD = 0x16,
+	OP_ALOAD = 0x19,
+	OP_ILOAD_0 = 0x1a,
+	OP_ILOAD_1 = 0x1b,
+	OP_ILOAD_3 = 0x1d,
+	OP_ALOAD_0 = 0x2a,
+	OP_ALOAD_1 = 0x2b,
+	OP_ISTORE = 0x36,
+	OP_LSTORE = 0x37,
+	OP_ASTORE = 0x3a,
+	OP_IADD = 0x60,
+	OP_IINC = 0x84,
+	OP_IFEQ = 0x99,
+	OP_IF_ICMPEQ = 0x9f,
+	OP_IF_ICMPLE = 0xa4,
+	OP_IF_ACMPNE = 0xa6,
+	OP_GOTO = 0xa7,
+	OP_JSR = 0xa8,
+	OP_RET = 0xa9,
+	OP_TABLESWITCH = 0xaa,
+	OP_LOOKUPSWITCH = 0xab,
+	OP_IRETURN = 0xac,
+	OP_LRETURN = 0xad,
+	OP_ARETURN = 0xb0,
+	OP_RETURN = 0xb1,
+	OP_GETSTATIC = 0xb2,
+	OP_PUTSTATIC = 0xb3,
+	OP_GETFIELD = 0xb4,
+	OP_PUTFIELD = 0xb5,
+	OP_INVOKEVIRTUAL = 0xb6,
+	OP_INVOKESPECIAL = 0xb7,
+	OP_INVOKESTATIC = 0xb8,
+	OP_INVOKEINTERFACE = 0xb9,
+	OP_ANEWARRAY = 0xbd,
+	OP_CHECKCAST = 0xc0,
+	OP_INSTANCEOF = 0xc1,
+	OP_WIDE = 0xc4,
+	OP_IFNULL = 0xc6,
+	OP_IFNONNULL = 0xc7,
+	OP_GOTO_W = 0xc8,
+	OP_JSR_W = 0xc9,
+
+	// Superinstructions; these are not part of the JVM instruction set, but installed by the
+	// translation into threaded code:
+	OP_THINJ_ALOAD_0_GETFIELD = 0xcb,
+	OP_THINJ_IINC_GOTO = 0xcc,
+	OP_THINJ_ICONST_IADD = 0xcd,
+	// if_icmpeq, if_icmpne, if_icmplt, if_icmpge, if_icmpgt, if_icmple (same order as the JVM):
+	OP_THINJ_ILOAD_ILOAD_IF_ICMPEQ = 0xce,
+	OP_THINJ_ILOAD_ILOAD_IF_ICMPLE = 0xd3,
+
+	// Quick instructions; installed by the instruction itself the first time it is executed, when
+	// the constant pool reference has been resolved:
+	OP_THINJ_GETSTATIC_QUICK = 0xd4,
+	OP_THINJ_PUTSTATIC_QUICK = 0xd5,
+	OP_THINJ_GETFIELD_QUICK = 0xd6,
+	OP_THINJ_PUTFIELD_QUICK = 0xd7,
+	OP_THINJ_INVOKESPECIAL_QUICK = 0xd8,
+	OP_THINJ_INVOKESTATIC_QUICK = 0xd9,
+	OP_THINJ_CHECKCAST_QUICK = 0xda,
+	OP_THINJ_INSTANCEOF_QUICK = 0xdb,
+	// invokevirtual of a method which isn't overridden; installed by the translation:
+	OP_THINJ_INVOKEVIRTUAL_QUICK = 0xdc,
+	// Invoke of an empty method; see tcGetIntrinsic():
+	OP_THINJ_INVOKE_EMPTY = 0xdd,
+	OP_THINJ_ANEWARRAY_QUICK = 0xde,
+	OP_THINJ_UNDEFINED = 0xfd,
+} OPCODE;
+
+struct __threadedInstruction;
+
+/**
+ * The operand of an instruction, decoded to native width during the translation:
+ */
+typedef union __threadedOperand {
+	// bipush, sipush: The sign extended value:
+	jint value;
+	// Local variable index or constant pool index:
+	u2 index;
+	// Branches: The branch target:
+	struct __threadedInstruction* target;
+	// iinc:
+	struct {
+		u1 index;
+		s1 delta;
+	} iinc;
+	// The superinstruction iload; iload; if_icmp<cond>:
+	struct {
+		u1 local1;
+		u1 local2;
+		// The distance from the first iload to the if_icmp<cond> instruction:
+		u1 branchOffset;
+	} icmp;
+	// Quick field instructions: The resolved field:
+	struct {
+		u2 address;
+		u1 size;
+	} field;
+	// Quick invoke instructions: The call stub of the resolved method. Also used by invokevirtual,
+	// if the method isn't overridden:
+	const callStub* stub;
+	// Quick anewarray: The resolved array class:
+	u2 classId;
+	// Invoke of an empty method: The number of arguments to discard:
+	u2 numberOfArguments;
+	// invokevirtual, invokeinterface: The inline cache of the call site:
+	inlineCache* cache;
+	// Quick checkcast and instanceof: The resolved class and the class of the last object which
+	// passed the test at this site:
+	struct {
+		u2 classId;
+		u2 lastClassId;
+	} typeCheck;
+} threadedOperand;
+
+/**
+ * A pre-decoded instruction. The threaded code is indexed by the program counter, i.e. the instruction
+ * at code[pc] is found at threadedCode[pc]; the entries of the operand bytes are unused. This way the
+ * program counter in frames, exception tables and line number tables remain byte code addresses.
+ * The threaded code is writable; instructions referring to the constant pool replace themselves by
+ * a quick variant holding the resolved reference (see QUICKEN in instructions.h).
+ *
+ * The tableswitch and lookupswitch instructions are long enough to keep their decoded operands in
+ * the operands of the entries following the instruction:
+ * - tableswitch: [pc+1] default target, [pc+2] low, [pc+3] high, [pc+4+i] target of low+i
+ * - lookupswitch: [pc+1] default target, [pc+2] npairs, [pc+3+2i] match i, [pc+4+2i] target of
+ *   match i. The matches are sorted in increasing order.
+ */
+typedef struct __threadedInstruction {
+	// The address of the instruction handler within execute():
+	const void* handler;
+	// The pre-decoded operand:
+	threadedOperand operand;
+} threadedInstruction;
+
+/**
+ * This method returns the threaded code. The code of all methods is translated the first time
+ * this method is called. The threaded code takes sizeof(threadedInstruction) bytes per byte of
+ * byte code in the VM tables area until the VM is reset.
+ * \param jumpTable The instruction handlers within execute(), indexed by opcode
+ * \return The threaded code, indexed by program counter
+ */
+threadedInstruction* tcGetThreadedCode(void* const jumpTable[]);
+
+/**
+ * This method classifies a method, which can be executed at the call site of an instance method
+ * without building a frame (an intrinsic):
+ * - A getter, 'aload_0; getfield; <t>return', is executed as the quick getfield
+ * - A setter, 'aload_0; <t>load_1; putfield; return', is executed as the quick putfield
+ * - An empty method, 'return', or a constructor only invoking an empty constructor,
+ *   'aload_0; invokespecial; return', is executed as OP_THINJ_INVOKE_EMPTY
+ * The receiver shall be checked for null by the intrinsic instruction, so the classification is
+ * for invokespecial and invokevirtual only.
+ * \param mic The invoked method
+ * \param operand The operand of the intrinsic instruction is stored here
+ * \return The opcode of the intrinsic instruction, or OP_THINJ_UNDEFINED, if the method shall be
+ * invoked the usual way
+ */
+OPCODE tcGetIntrinsic(const methodInClass* mic, threadedOperand* operand);
+
+/**
+ * This method discards the threaded code. Shall be called when the VM is reset, since the threaded
+ * code is allocated in the VM tables area.
+ */
+void tcReset(void);
+
+/**
+ * This method returns the length of the instruction at code[pc]
+ * \param methodStart The address of the first instruction in the method containing pc
+ * \param pc The address of the instruction
+ * \return The length of the instruction, including operands, in bytes
+ */
+u2 tcGetInstructionLength(codeIndex methodStart, codeIndex pc);
+
+#endif /* THREADEDCODE_H_ */
@@ -60,6 +60,11 @@ typedef union __stackableOperand {
 	jint jrenameint;
 	jobject jref;
 	u2 u2val;
+	// Two u2 values in one stackable; used by the frame records:
+	struct {
+		u2 first;
+		u2 second;
+	} u2pair;
 } stackableOperand;
 
 typedef enum {
@@ -150,6 +155,15 @@ typedef union __header {
 		// Current mark-and-sweep value:
 		unsigned int mark :MARK_BIT_SIZE;
 
+		// Set, if the element is in the remembered set of the nursery; see heap.c:
+		unsigned int remembered :1;
+
+		// Set, if the element shall never be moved by compaction (like HT_PROTECTED elements):
+		unsigned int pinned :1;
+
+		// Set, if the element is marked, but its references are not scanned yet (grey); see heap.c:
+		unsigned int grey :1;
+
 		// The id of the class in this element:
 		u2 classId;
 
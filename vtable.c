@@ -0,0 +1,189 @@
+/*
+ * vtable.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "types.h"
+#include "config.h"
+#include "constantpool.h"
+#include "heap.h"
+#include "vtable.h"
+
+// The tables, indexed by class id; NULL until built:
+static vtable* vtables = NULL;
+
+/**
+ * This method builds the vtable of a class, and of its super classes, if not already built
+ * \return The vtable of the class
+ */
+static const vtable* sBuildVtable(u2 classId) {
+	vtable* vt = &vtables[classId];
+
+	if (vt->methods == NULL && vt->size == 0) {
+		const constantPool* cp = &allConstantPools[classId];
+		const vtable* super = NULL;
+		if (classId != JAVA_LANG_OBJECT_CLASS_ID) {
+			super = sBuildVtable(allClassInstanceInfo[classId].superClassId);
+		}
+
+		if (super != NULL && cp->numberOfMethods == 0) {
+			// Nothing declared; share the vtable of the super class:
+			vt->size = super->size;
+			vt->methods = super->methods;
+		} else {
+			u2 superSize = super != NULL ? super->size : 0;
+
+			// Count the slots; overriding methods reuse the slot of the super class:
+			int i;
+			u2 size = superSize;
+			for (i = 0; i < cp->numberOfMethods; i++) {
+				if (super == NULL || vtGetSlot(allClassInstanceInfo[classId].superClassId,
+						cp->methods[i].linkId) < 0) {
+					size++;
+				}
+			}
+
+			const methodInClass** methods = NULL;
+			if (size > 0) {
+				methods = heapAllocPermanent(size * sizeof(const methodInClass*));
+			}
+			for (i = 0; i < superSize; i++) {
+				methods[i] = super->methods[i];
+			}
+
+			u2 next = superSize;
+			for (i = 0; i < cp->numberOfMethods; i++) {
+				int slot = -1;
+				if (super != NULL) {
+					slot = vtGetSlot(allClassInstanceInfo[classId].superClassId, cp->methods[i].linkId);
+				}
+				if (slot < 0) {
+					slot = next++;
+				}
+				methods[slot] = &cp->methods[i];
+			}
+
+			vt->size = size;
+			vt->methods = methods;
+		}
+	}
+
+	return vt;
+}
+
+/**
+ * This method builds the itable of a class. The vtable of the class shall be built.
+ */
+static void sBuildItable(u2 classId) {
+	vtable* vt = &vtables[classId];
+	const classInstanceInfoDef* classInfo = &allClassInstanceInfo[classId];
+
+	if (classInfo->interface_count == 0) {
+		return;
+	}
+
+	vt->itableOffsets = heapAllocPermanent(classInfo->interface_count * sizeof(u2));
+
+	int i;
+	u2 size = 0;
+	for (i = 0; i < classInfo->interface_count; i++) {
+		vt->itableOffsets[i] = size;
+		size += allConstantPools[implementedInterfaces[classInfo->interface_start + i]].numberOfMethods;
+	}
+
+	if (size > 0) {
+		vt->itableMethods = heapAllocPermanent(size * sizeof(const methodInClass*));
+		for (i = 0; i < classInfo->interface_count; i++) {
+			const constantPool* icp = &allConstantPools[implementedInterfaces[classInfo->interface_start
+					+ i]];
+			int j;
+			for (j = 0; j < icp->numberOfMethods; j++) {
+				vt->itableMethods[vt->itableOffsets[i] + j] = vtGetMethodByLinkId(classId,
+						icp->methods[j].linkId);
+			}
+		}
+	}
+}
+
+void vtReset(void) {
+	vtables = heapAllocPermanent(numberOfAllClassInstanceInfo * sizeof(vtable));
+
+	int i;
+	for (i = 0; i < numberOfAllClassInstanceInfo; i++) {
+		sBuildVtable(i);
+	}
+
+	for (i = 0; i < numberOfAllClassInstanceInfo; i++) {
+		sBuildItable(i);
+	}
+}
+
+int vtGetSlot(u2 classId, u2 linkId) {
+	const vtable* vt = &vtables[classId];
+
+	int slot;
+	for (slot = vt->size - 1; slot >= 0; slot--) {
+		if (vt->methods[slot]->linkId == linkId) {
+			break;
+		}
+	}
+
+	return slot;
+}
+
+int vtGetInterfaceSlot(u2 interfaceId, u2 linkId) {
+	const constantPool* cp = &allConstantPools[interfaceId];
+
+	int slot;
+	for (slot = cp->numberOfMethods - 1; slot >= 0; slot--) {
+		if (cp->methods[slot].linkId == linkId) {
+			break;
+		}
+	}
+
+	return slot;
+}
+
+const methodInClass* vtGetMethod(u2 classId, u2 slot) {
+	return vtables[classId].methods[slot];
+}
+
+const methodInClass* vtGetInterfaceMethod(u2 classId, u2 interfaceId, u2 slot) {
+	const vtable* vt = &vtables[classId];
+	const classInstanceInfoDef* classInfo = &allClassInstanceInfo[classId];
+	const methodInClass* mic = NULL;
+
+	int i;
+	for (i = 0; i < classInfo->interface_count; i++) {
+		if (implementedInterfaces[classInfo->interface_start + i] == interfaceId) {
+			mic = vt->itableMethods[vt->itableOffsets[i] + slot];
+			break;
+		}
+	}
+
+	return mic;
+}
+
+const methodInClass* vtGetMonomorphicMethod(u2 classId, u2 slot) {
+	const methodInClass* mic = vtables[classId].methods[slot];
+
+	int i;
+	for (i = 0; i < numberOfAllClassInstanceInfo && mic != NULL; i++) {
+		// Interfaces have no instances, so only classes can be receivers:
+		if (i != classId && getClassType(i) != CT_INTERFACE && is_S_SubClassing_T(i, classId)) {
+			if (slot >= vtables[i].size || vtables[i].methods[slot] != mic) {
+				// Overridden:
+				mic = NULL;
+			}
+		}
+	}
+
+	return mic;
+}
+
+const methodInClass* vtGetMethodByLinkId(u2 classId, u2 linkId) {
+	int slot = vtGetSlot(classId, linkId);
+
+	return slot >= 0 ? vtables[classId].methods[slot] : NULL;
+}
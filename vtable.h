@@ -0,0 +1,89 @@
+/*
+ * vtable.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef VTABLE_H_
+#define VTABLE_H_
+
+#include "types.h"
+#include "constantpool.h"
+
+/**
+ * The dispatch tables of a class. The vtable contains all methods of the class, including the
+ * inherited ones. A method overriding a method in the super class has the slot of the overridden
+ * method, so a slot found in the referenced class is valid for all sub classes as well.
+ */
+typedef struct __vtable {
+	// The number of slots:
+	u2 size;
+	// The methods, indexed by slot. Shared with the super class, if the class doesn't declare any
+	// methods:
+	const methodInClass** methods;
+	// The start in 'itableMethods' of the methods of each implemented interface; indexed in
+	// the same order as the interfaces in implementedInterfaces[]:
+	u2* itableOffsets;
+	// The methods implementing the interface methods; ordered as the methods of the interface:
+	const methodInClass** itableMethods;
+} vtable;
+
+/**
+ * This method builds the vtables and itables of all classes. Shall be called when the VM is reset,
+ * since the tables are allocated in the VM tables area.
+ */
+void vtReset(void);
+
+/**
+ * This method looks up the vtable slot of a method
+ * \param classId The class to look in
+ * \param linkId The linkId of the method
+ * \return The slot, or -1, if the class has no such method
+ */
+int vtGetSlot(u2 classId, u2 linkId);
+
+/**
+ * This method looks up the itable slot of an interface method
+ * \param interfaceId The interface to look in
+ * \param linkId The linkId of the method
+ * \return The slot, or -1, if the interface declares no such method
+ */
+int vtGetInterfaceSlot(u2 interfaceId, u2 linkId);
+
+/**
+ * This method returns the method in a vtable slot
+ * \param classId The class of the receiver
+ * \param slot The slot as returned by vtGetSlot() for the receiver class or one of its super classes
+ * \return The method
+ */
+const methodInClass* vtGetMethod(u2 classId, u2 slot);
+
+/**
+ * This method returns the method implementing an interface method
+ * \param classId The class of the receiver
+ * \param interfaceId The interface
+ * \param slot The slot as returned by vtGetInterfaceSlot()
+ * \return The method, or NULL, if the class doesn't implement the interface method
+ */
+const methodInClass* vtGetInterfaceMethod(u2 classId, u2 interfaceId, u2 slot);
+
+/**
+ * This method finds the method in a vtable slot, if the slot isn't overridden by any sub class.
+ * Since all classes are known, a call site referring to the slot will always invoke this method.
+ * Shall be called after the type tables are built; see cpBuildTypeTables().
+ * \param classId The referenced class
+ * \param slot The slot as returned by vtGetSlot()
+ * \return The method, or NULL, if a sub class overrides the method
+ */
+const methodInClass* vtGetMonomorphicMethod(u2 classId, u2 slot);
+
+/**
+ * This method looks up a method in the vtable of a class by linkId. The search is independent of
+ * the depth of the class hierarchy, since the vtable contains the inherited methods as well.
+ * \param classId The class of the receiver
+ * \param linkId The linkId of the method
+ * \return The method, or NULL, if not found
+ */
+const methodInClass* vtGetMethodByLinkId(u2 classId, u2 linkId);
+
+#endif /* VTABLE_H_ */